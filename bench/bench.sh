@@ -0,0 +1,160 @@
+#!/bin/bash
+
+# Measures the throughput of the grading pipeline (pull.sh, grade.sh,
+# MakefileGrade and bin/test) on a synthetic class. Every student is a copy of
+# a reference solution, some broken on purpose, served from local git repos.
+
+BENCH=$(cd "$(dirname "$0")" && pwd) # directory of this script
+REPO=$(dirname $BENCH)               # the grading repository
+WORK="$PWD/bench_work"               # workspace for the synthetic class
+REFERENCE=""                         # a working solution of the homework
+HWDIR="HW_5"                         # homework directory
+STUDENTREPO="AutomatedGTestGradingExample" # must match pull.sh and grade.sh
+NUM=20                               # number of students
+MIX="correct:6,crash:1,loop:1,memory:1,broken:1" # relative share of each kind of student
+EXECUTOR="docker"                    # passed to grade.sh -e
+TIMEOUT=120                          # passed to grade.sh -t
+COMMITDATE="2019-02-01 12:00:00"     # date of every student commit
+DUEDATE="2019-02-10"
+
+###### OPTIONS ######
+while getopts r:h:n:m:e:t:o: option
+do
+case "${option}"
+in
+r) REFERENCE=${OPTARG};; # directory with a working solution, e.g. a student's HW_5
+h) HWDIR=${OPTARG};;
+n) NUM=${OPTARG};;
+m) MIX=${OPTARG};;
+e) EXECUTOR=${OPTARG};;
+t) TIMEOUT=${OPTARG};;
+o) WORK=${OPTARG};;
+esac
+done
+shift $((OPTIND -1))
+GRADEARGS="$@"                       # anything after -- is passed on to grade.sh
+
+function usage() {
+    echo "Usage: bash bench/bench.sh -r <reference solution> [options] [-- grade.sh options]"
+    echo "-r   Directory with a working solution of the homework (required)"
+    echo "-h   Homework directory (default 'HW_5')"
+    echo "-n   Number of students (default 20)"
+    echo "-m   Mix of students, e.g. 'correct:6,crash:1,loop:1,memory:1,broken:1'"
+    echo "     correct: the reference solution"
+    echo "     crash:   occurrence_map dereferences a null pointer"
+    echo "     loop:    sort_by_magnitude never returns"
+    echo "     memory:  sort_by_magnitude fills 64MB on every call"
+    echo "     broken:  utilities.cc does not compile"
+    echo "-e   Where grade.sh builds and runs student code: 'docker' (default), 'sandbox' or 'local'"
+    echo "-t   Seconds before grade.sh kills the tests of a student (default 120)"
+    echo "-o   Workspace directory (default ./bench_work), emptied first"
+}
+
+if ! [[ -e $REFERENCE/main.cc ]];
+then
+    echo "OPPS! '-r' must be a directory with a working solution (no main.cc in '$REFERENCE')."
+    usage
+    exit 1
+fi
+
+###### FUNCTIONS ######
+
+# Inserts the statement $3 at the top of the body of function $2 in file $1.
+function inject() {
+  awk -v name="$2" -v stmt="$3" '
+    !done && $0 ~ ("(^|[^A-Za-z0-9_])" name "[ \t]*\\(") { found = 1 }
+    found && !done && /\{/ { print; print "    " stmt; done = 1; next }
+    { print }' "$1" > "$1.tmp" && mv "$1.tmp" "$1"
+}
+
+# Turns the copy of the reference solution in directory $1 into a student of kind $2.
+function mutate() {
+  case $2 in
+    crash) inject $1/utilities.cc occurrence_map '*(volatile int*) 0 = 0;';;
+    loop) inject $1/utilities.cc sort_by_magnitude 'for (volatile int spin = 0; ; spin++) {}';;
+    memory) inject $1/utilities.cc sort_by_magnitude '{ std::vector<char> hog(64 << 20, 1); }';;
+    broken) echo "this does not compile" >> $1/utilities.cc;;
+  esac
+}
+
+# Creates a local git repo at $1 with the files in $2 committed to master
+# under directory $HWDIR.
+function make_repo() {
+  mkdir -p $1/$HWDIR
+  cp -r $2/. $1/$HWDIR/
+  (
+    cd $1
+    git init -q
+    git symbolic-ref HEAD refs/heads/master
+    git add -A
+    GIT_AUTHOR_DATE="$COMMITDATE" GIT_COMMITTER_DATE="$COMMITDATE" \
+      git -c user.name=bench -c user.email=bench@localhost commit -q -m "$HWDIR"
+  )
+}
+
+function now() {
+  date +%s.%N
+}
+
+function elapsed() {
+  awk -v start=$1 -v end=$2 'BEGIN {printf "%.1f", end - start}'
+}
+
+###### SETUP ######
+echo "***** SETUP *****"
+rm -rf $WORK
+mkdir -p $WORK/remotes
+ln -s $REPO/grading $WORK/grading
+make_repo $WORK/remotes/klavins/ECEP520 $REPO/grading
+
+kinds=""
+for entry in $(echo $MIX | tr ',' ' ');
+do
+  for i in $(seq ${entry#*:});
+  do
+    kinds="$kinds ${entry%%:*}"
+  done
+done
+kinds=($kinds)
+
+for i in $(seq 1 $NUM);
+do
+  kind=${kinds[$(( (i - 1) % ${#kinds[@]} ))]}
+  login="$(printf "student%03d" $i)-$kind"
+  mkdir -p $WORK/src/$login
+  cp -r $REFERENCE/. $WORK/src/$login/
+  mutate $WORK/src/$login $kind
+  make_repo $WORK/remotes/$login/$STUDENTREPO $WORK/src/$login
+  echo "Bench,$kind,$login" >> $WORK/students.csv
+done
+echo "Created $NUM students in $WORK/remotes"
+echo "***** END SETUP *****"
+
+###### BENCHMARK ######
+cd $WORK
+start=$(now)
+bash $REPO/pull.sh -r file://$WORK/remotes -i students.csv > pull.log 2>&1
+pulled=$(now)
+bash $REPO/grade.sh -h $HWDIR -i students.csv -d $DUEDATE -e $EXECUTOR -t $TIMEOUT $GRADEARGS > grade.log 2>&1
+graded=$(now)
+
+###### REPORT ######
+{
+  echo "Students      : $NUM ($MIX)"
+  echo "Executor      : $EXECUTOR"
+  echo "Pull          : $(elapsed $start $pulled) s"
+  echo "Grade         : $(elapsed $pulled $graded) s"
+  echo "Students/hour : $(awk -v n=$NUM -v t=$(elapsed $start $graded) 'BEGIN {printf "%.0f", n * 3600 / t}')"
+  echo ""
+  echo "Seconds per stage:"
+  awk -F, '!($2 in total) { order[++stages] = $2 }
+    { total[$2] += $3; n[$2]++; if ($3 > max[$2]) max[$2] = $3 }
+    END { printf "  %-10s %9s %9s %9s\n", "stage", "total", "mean", "max"
+          for (i = 1; i <= stages; i++) {
+            s = order[i]
+            printf "  %-10s %9.2f %9.2f %9.2f\n", s, total[s], total[s] / n[s], max[s]
+          } }' results/timing.csv
+  echo ""
+  echo "Grades by kind of student:"
+  awk -F, '{ printf "  %-8s %-24s %s\n", $2, $3, ($4 == "" ? "no grade" : $4) }' results/summary.csv
+} | tee report.txt
@@ -9,15 +9,42 @@ DUEDATE=""                          # the due date of the homework
 
 GRADING=$PWD/grading                # path to grading directory, should contain makefile, main, and unit_test
 TESTVER=""
-MAKE="MakefileGrade$TESTVER"        # name of the makefile to use for compiling
+MAKE="MakefileGrade"                # name of the makefile to use for compiling, suffixed with -v
 TEST="unit_tests_grading*.c"        # name of the unit_test file
 MAIN="main_grading.c"               # name of the main file for tests
+TESTARGS=""                         # extra arguments passed to the test binary
+MAKEARGS=""                         # extra arguments passed to make
+DEPMAP="DependencyMap.txt"          # maps each question to the student sources it exercises
+VERSIONS="SuiteVersions.txt"        # versions of the test suite graded in the same run, if any
+CACHE=""                            # if 1, only rerun questions whose student sources changed
+EXECUTOR="docker"                   # where student code is built and run: docker, sandbox or local
+IMAGE="klavins/ecep520:cppenv"      # docker image of '-e docker'
+TOOLS="$(cd "$(dirname "$0")" && pwd)/tools" # helper programs shipped next to this script
+SANDBOX="$TOOLS/bin/sandbox"        # namespace sandbox used by '-e sandbox'
+TIMEOUT=""                          # if set, seconds before the test binary is killed
+REPRO=""                            # if 1, keep a bundle to rerun each failed test on its own
+PINCPUS=""                          # if set, CPUs each student's build and tests are pinned to
+TIMINGCPUS=1                        # CPUs kept for the timing tests alone when pinning
+TIMINGFILTER="*Complexity*:*Benchmark*" # gtest filter of the tests whose grade depends on timing, unless $DEPMAP declares them
+EVENTS=""                           # if set, Unix socket of a tools/bin/gradewatch to publish test events to
+JOBS=""                             # if set, cores shared by every build and test run
+OBJCACHE=""                         # if set, directory caching compiled objects across students and runs
+WORKSPACE="/dev/shm"                # RAM-backed directory students are extracted and built in
+WORKERS=1                           # number of students graded at once
+DURATIONS="$DIR/durations.csv"      # "homework,login,seconds" of past runs, kept across runs
+DEFAULTDURATION=60                  # expected seconds for a student with no past runs
 
 SUMMARY="$RESULTS/summary.csv"
+TIMING="$RESULTS/timing.csv"        # seconds spent in each stage, per student
+PLACEMENT="$RESULTS/placement.csv"  # CPUs and NUMA node each phase of the tests ran on, per student
 GRADEPATTERN="HOMEWORK_GRADE:" # pattern to look for from main.c to build the summary
+VERSIONPATTERN="VERSION_GRADE:"     # pattern of the grade of each suite version
+TALLYPATTERN="QUESTION_TALLY:"      # pattern of the tests passed of each question
+VERSIONTALLYPATTERN="VERSION_TALLY:" # pattern of the tests passed of each question, per suite version
+WEIGHTEDPATTERN="WEIGHTED_GRADE:"   # pattern of the grade weighted by question points
 
 ###### OPTIONS ######
-while getopts i:h:l:v:a:d: option
+while getopts i:h:l:v:a:d:c:f:s:b:A:e:t:o:j:J:C:r:P:L: option
 do
 case "${option}"
 in
@@ -26,10 +53,25 @@ h) HWDIR=${OPTARG};;    # this weeks homework directory name
 l) login=${OPTARG};;    # optionally provide a single login to evalute just one student
 v) TESTVER=${OPTARG};;
 a) APPEND=${OPTARG};;   # if 1, appends result to tmp and results folders
-d) DUEDATE=${OPTARG};;  # due date for the homework
+d) DUEDATE=${OPTARG};;  # due date for the homework, or a comma separated list of them
+c) CACHE=${OPTARG};;    # if 1, reuse cached question results for unchanged student code
+f) TESTARGS="$TESTARGS --grade_failfast=${OPTARG}";; # fail the rest of a test after N identical crashes
+s) TESTARGS="$TESTARGS --grade_seed=${OPTARG}";;     # seed for generated test cases and data
+b) TESTARGS="$TESTARGS --grade_budget=${OPTARG}";;   # multiplies the per-question time budgets
+A) MAKEARGS="$MAKEARGS ALLOC=${OPTARG}";;            # if 1, count heap allocations of each test
+e) EXECUTOR=${OPTARG};; # docker, sandbox or local
+t) TIMEOUT=${OPTARG};;  # seconds before the test binary is killed
+o) TESTARGS="$TESTARGS --grade_capture=${OPTARG}";;  # bytes of output kept per test, as head,tail
+j) WORKERS=${OPTARG};;  # number of students graded at once
+J) JOBS=${OPTARG};;     # cores shared by every build and test run
+C) OBJCACHE=${OPTARG};; # directory caching compiled objects
+r) REPRO=${OPTARG};;    # if 1, keep a repro bundle for each failed test
+P) PINCPUS=${OPTARG};;  # CPUs each student is pinned to
+L) EVENTS=${OPTARG};;   # socket of a gradewatch showing the run live
 esac
 done
 shift $((OPTIND -1))
+MAKE="$MAKE$TESTVER"
 
 function usage() {
     echo "Usage:"
@@ -37,7 +79,21 @@ function usage() {
     echo "-l   Student's github login (optional)"
     echo "-i   Filepath of csv of all students [LAST_NAME,FIRST_NAME,GITHUB_LOGIN]"
     echo "-a   If 1, append student results to results dictionary. If 0, rm -rf results dictionary"
-    echo "-d   The due date for the assignment e.g. '2019-01-21'"
+    echo "-d   The due date for the assignment e.g. '2019-01-21', or several e.g. '2019-01-21,2019-01-28'"
+    echo "-c   If 1, only rerun the questions whose student sources changed since the last run"
+    echo "-f   Fail the remaining instances of a parameterized test once its first N instances crash the same way"
+    echo "-s   Seed for the generated test cases and data (default 520)"
+    echo "-b   Scale the per-question test generation time budgets, e.g. 0.5"
+    echo "-A   If 1, count the heap allocations of each test and grade allocation budgets"
+    echo "-e   Where to build and run student code: 'docker' (default), 'sandbox' or 'local'"
+    echo "-t   Kill the tests of a student after this many seconds"
+    echo "-o   Keep only the first and last bytes of what each test prints, e.g. '2048,2048'"
+    echo "-j   Grade this many students at once, longest expected first (default 1)"
+    echo "-J   Share this many cores between all builds and test runs through one jobserver"
+    echo "-C   Cache compiled objects in this directory, shared by all students and runs (with '-e sandbox')"
+    echo "-r   If 1, keep a bundle in results/<HW>/repro/<login> to rerun each failed test on its own"
+    echo "-P   Pin each student to this many CPUs of one NUMA node, and run timing tests alone on reserved CPUs"
+    echo "-L   Publish every test to the gradewatch listening on this Unix socket"
 }
 
 if ! [[ $HWDIR ]];
@@ -52,64 +108,722 @@ function no_white_space() {
     echo $NO_WHITESPACE
 }
 
+# Appends the seconds since the previous stage of the current student to
+# $TIMING as "login,stage,seconds".
+function stage_done() {
+  now=$(date +%s.%N)
+  echo "$key,$1,$(awk -v start=$STAGE_START -v end=$now 'BEGIN {printf "%.3f", end - start}')" >> $TIMING
+  STAGE_START=$now
+}
+
+# Starts the environment student code is built and run in. Must be called
+# from the student's homework directory.
+function start_runner() {
+  if [[ $EXECUTOR == "local" ]] || [[ $EXECUTOR == "sandbox" ]];
+  then
+    RUNDIR=$PWD
+  else
+    echo "Creating docker container..."
+    CONTAINERID="$(docker run -v $PWD:/source ${SLOTCPUS:+--cpuset-cpus=$SLOTCPUS} ${EVENTS:+-v $(dirname $EVENTS):$(dirname $EVENTS)} -di $IMAGE)"
+    echo "Docker container created with id $CONTAINERID"
+  fi
+}
+
+# Runs a command in the student's homework directory, inside the runner.
+function run() {
+  if [[ $EXECUTOR == "local" ]];
+  then
+    (cd $RUNDIR && $PIN "$@")
+  elif [[ $EXECUTOR == "sandbox" ]];
+  then
+    $PIN $SANDBOX -d $RUNDIR $LAYERS $SANDBOXARGS -- "$@"
+  else
+    docker exec $CONTAINERID "$@"
+  fi
+}
+
+# Runs the test binary with the given arguments, killing it after $TIMEOUT
+# seconds if set. With $EVENTS, it also publishes each test to gradewatch.
+function run_tests() {
+  if [[ $EVENTS ]];
+  then
+    set -- "$@" --grade_events=$EVENTS,$key
+    if [[ $EXECUTOR == "sandbox" ]];
+    then
+      local SANDBOXARGS="-b $(dirname $EVENTS)"
+    fi
+  fi
+  if [[ $TIMEOUT ]];
+  then
+    run timeout -k 10 $TIMEOUT ./bin/test "$@"
+    status=$?
+    if [[ $status -eq 124 ]] || [[ $status -eq 137 ]];
+    then
+      echo "ERROR: tests timed out after $TIMEOUT seconds"
+    fi
+  else
+    run ./bin/test "$@"
+  fi
+}
+
+# Runs the timing tests, gtest filter $1, alone on the CPUs reserved for
+# them, once every other test ran on the student's own CPUs, and prints
+# the outputs of both, with their grades and tallies renamed PHASE_*, then
+# the grades of both together (merge_phases), like run_incremental.
+# Both phases take the rest of the arguments, those of run_tests. If $1 is
+# empty, or $LISTTIMING is set and the tests list none of $1, there is no
+# timing phase: the tests run once on the student's CPUs.
+function run_placed_tests() {
+  timingfilter=$1
+  shift
+  if [[ $timingfilter ]] && [[ $LISTTIMING ]] && ! run ./bin/test --gtest_list_tests --grade_filter="$timingfilter" "$@" | grep -q '^  ';
+  then
+    timingfilter=""
+  fi
+  started=$(date +%s.%N)
+  if ! [[ $timingfilter ]];
+  then
+    run_tests "$@"
+    placed $started tests $SLOTCPUS $SLOTNODE
+    return
+  fi
+  other="$(run_tests --grade_filter="-$timingfilter" "$@")"
+  placed $started tests $SLOTCPUS $SLOTNODE
+
+  # one student at a time on the timing CPUs
+  while ! mkdir $CORES/timing.lease 2>/dev/null;
+  do
+    sleep 0.05
+  done
+  started=$(date +%s.%N)
+  if [[ $EXECUTOR == "docker" ]];
+  then
+    docker update --cpuset-cpus=$TIMINGSET $CONTAINERID > /dev/null
+  fi
+  timing="$(PIN="taskset -c $TIMINGSET" run_tests --grade_filter="$timingfilter" "$@")"
+  if [[ $EXECUTOR == "docker" ]];
+  then
+    docker update --cpuset-cpus=$SLOTCPUS $CONTAINERID > /dev/null
+  fi
+  rmdir $CORES/timing.lease
+  placed $started timing $TIMINGSET $TIMINGNODE
+
+  for phase in "$other" "$timing"
+  do
+    echo "$phase" | sed -e "s/^$GRADEPATTERN/PHASE_GRADE:/" -e "s/^$VERSIONPATTERN/PHASE_$VERSIONPATTERN/" \
+      -e "s/^$TALLYPATTERN/PHASE_$TALLYPATTERN/" -e "s/^$VERSIONTALLYPATTERN/PHASE_$VERSIONTALLYPATTERN/" \
+      -e "s/^$WEIGHTEDPATTERN/PHASE_$WEIGHTEDPATTERN/"
+  done
+  echo "$other"$'\n'"$timing" | merge_phases
+}
+
+# Reads the outputs of both phases of run_placed_tests and, if both
+# reported a HOMEWORK_GRADE, prints the question and version tallies of
+# both summed, the weighted and version grades recomputed from them as the
+# test binary does (QuestionRegistry::grade), and the HOMEWORK_GRADE.
+function merge_phases() {
+  awk -v grade=$GRADEPATTERN -v version=$VERSIONPATTERN -v question=$TALLYPATTERN \
+      -v versiontally=$VERSIONTALLYPATTERN -v weighted=$WEIGHTEDPATTERN '
+    function add(group, id, name, counts, points,   key, c) {
+      key = group " " id
+      if (!(key in tests)) { keys[++n] = key; groups[key] = group; names[key] = name; weights[key] = points }
+      split(counts, c, "/"); passed[key] += c[1]; tests[key] += c[2]
+    }
+    function report(group,   k, key, p, t, earned, total) {
+      for (k = 1; k <= n; k++) {
+        key = keys[k]
+        if (groups[key] != group) continue
+        print key, names[key], passed[key] "/" tests[key], weights[key]
+        p += passed[key]; t += tests[key]
+        if (tests[key] > 0) { earned += passed[key] / tests[key] * weights[key]; total += weights[key] }
+      }
+      sum = p "/" t
+      return total > 0 ? earned / total * 100 : 0
+    }
+    $1 == question { add(question, $2, $3, $4, $5) }
+    $1 == versiontally {
+      if (!($2 in listed)) { listed[$2]; versions[++nv] = $2 }
+      add(versiontally " " $2, $3, $4, $5, $6)
+    }
+    $1 == grade { split($2, g, "/"); graded++; homework_passed += g[1]; homework_tests += g[2] }
+    END {
+      if (graded != 2) exit
+      print ""
+      printf "%s %g\n", weighted, report(question)
+      for (v = 1; v <= nv; v++) grades[v] = report(versiontally " " versions[v]) " " sum
+      for (v = 1; v <= nv; v++) { split(grades[v], g, " "); printf "%s %s %s %g\n", version, versions[v], g[2], g[1] }
+      print "\n" grade, homework_passed "/" homework_tests
+    }'
+}
+
+# Prints and records in $PLACEMENT where a phase of the tests
+# ran: $1 its start, $2 the phase, $3 the CPUs and $4 their NUMA node.
+function placed() {
+  seconds=$(awk -v start=$1 -v end=$(date +%s.%N) 'BEGIN {printf "%.3f", end - start}')
+  echo "PLACEMENT: $2 on CPUs $3 (node $4) for ${seconds}s"
+  echo "$key,$2,\"$3\",$4,$seconds" >> $PLACEMENT
+}
+
+# Prints the CPUs of a list such as "0-3,8", one per line.
+function expand_cpus() {
+  echo "$1" | tr ',' '\n' | awk -F'-' 'NF { last = $2 == "" ? $1 : $2; for (c = $1; c <= last; c++) print c }'
+}
+
+# Keeps the last $TIMINGCPUS online CPUs, away from CPU 0 and the
+# interrupts it tends to get, for the timing tests, and splits the rest
+# into slots of $PINCPUS CPUs that each lie within one NUMA node, so the
+# memory of a student pinned to a slot stays local. Each slot is written to
+# $CORES/slot.<n> as "<cpus> <node>".
+function start_placement() {
+  CORES="$SCRATCH/cores"
+  mkdir -p $CORES
+  cpus="$(for node in /sys/devices/system/node/node[0-9]*
+          do
+            for cpu in $(expand_cpus $(cat $node/cpulist 2>/dev/null))
+            do
+              echo "$cpu ${node##*node}"
+            done
+          done)"
+  if ! [[ $cpus ]];
+  then
+    cpus="$(expand_cpus $(cat /sys/devices/system/cpu/online) | sed 's/$/ 0/')"
+  fi
+  total=$(echo "$cpus" | grep -c .)
+  if [[ $total -le $TIMINGCPUS ]];
+  then
+    echo "WARNING: only $total CPUs, so the timing tests share them with the other tests"
+    timing="$cpus"
+    shared="$cpus"
+  else
+    timing="$(echo "$cpus" | tail -n $TIMINGCPUS)"
+    shared="$(echo "$cpus" | head -n $((total - TIMINGCPUS)))"
+  fi
+  TIMINGSET="$(echo "$timing" | cut -d' ' -f1 | paste -sd,)"
+  # the timing tests the questions declare, if any, instead of the default
+  declared="$(grep -v '^#' $GRADING/$HWDIR/$DEPMAP 2>/dev/null | awk -F' %%:%% ' '$4 != "" {print $4}' | paste -sd:)"
+  if [[ $declared ]];
+  then
+    TIMINGFILTER=$declared
+    TIMINGDECLARED=1
+  fi
+  TIMINGNODE="$(echo "$timing" | cut -d' ' -f2 | sort -u | paste -sd,)"
+  echo "$shared" | awk -v size=$PINCPUS -v dir=$CORES '
+    NR == 1 || $2 != node || count == size {
+      if (count > 0) print list, node > (dir "/slot." n++)
+      list = ""; count = 0; node = $2
+    }
+    { list = list (count > 0 ? "," : "") $1; count++ }
+    END { if (count > 0) print list, node > (dir "/slot." n++) }'
+  slots=$(ls $CORES/slot.* | wc -l)
+  echo "Pinning students to $slots slots of up to $PINCPUS CPUs, timing tests to CPUs $TIMINGSET (node $TIMINGNODE)"
+  if [[ $slots -lt $WORKERS ]];
+  then
+    echo "WARNING: $WORKERS workers share $slots slots, so some wait for a free slot"
+  fi
+}
+
+# Takes a free slot of CPUs for the current student, waiting for one if
+# every slot is taken, and pins what run starts to it until release_cpus.
+function lease_cpus() {
+  while true
+  do
+    for slot in $CORES/slot.*
+    do
+      if mkdir $slot.lease 2>/dev/null;
+      then
+        SLOT=$slot
+        read SLOTCPUS SLOTNODE < $slot
+        PIN="taskset -c $SLOTCPUS"
+        return
+      fi
+    done
+    sleep 0.1
+  done
+}
+
+function release_cpus() {
+  rmdir $SLOT.lease
+  SLOT=""
+  SLOTCPUS=""
+  PIN=""
+}
+
+# Runs a command while holding a token of the jobserver, if there is one, so
+# at most $JOBS builds and test runs of all students use the cores at once.
+# Only make, marked by '-m', gets the jobserver's pipe to draw more tokens
+# from; student code never sees it.
+function with_token() {
+  share=""
+  if [[ $1 == "-m" ]];
+  then
+    share=1
+    shift
+  fi
+  if ! [[ $JOBFD ]];
+  then
+    "$@"
+    return
+  fi
+  read -r -n 1 -u $JOBFD token
+  if [[ $share ]];
+  then
+    "$@"
+  else
+    "$@" {JOBFD}>&-
+  fi
+  status=$?
+  printf '%s' "$token" >&$JOBFD
+  return $status
+}
+
+# Starts the jobserver holding the $JOBS tokens. make draws the tokens for
+# its parallel jobs from it through MAKEFLAGS, besides the one with_token
+# holds for it; docker containers cannot share it, so they only hold that one.
+function start_jobserver() {
+  JOBFIFO="$SCRATCH/jobserver"
+  mkdir -p $SCRATCH $RESULTS
+  $TOOLS/bin/jobserver -j $JOBS -f $JOBFIFO -o $RESULTS/utilization.csv &
+  JOBSERVER=$!
+  while ! [[ -p $JOBFIFO ]];
+  do
+    if ! kill -0 $JOBSERVER 2>/dev/null;
+    then
+      echo "ERROR: the jobserver did not start"
+      exit 1
+    fi
+    sleep 0.05
+  done
+  exec {JOBFD}<>$JOBFIFO
+  if [[ $EXECUTOR != "docker" ]];
+  then
+    MAKEJOBS="-j$JOBS --jobserver-auth=$JOBFD,$JOBFD"
+  fi
+}
+
+# Compiles through tools/objcache.sh, which keeps each object in $OBJCACHE
+# under the hash of its preprocessed source and flags. Only the sandbox can
+# keep the cache from the tests: anywhere else, a student's tests could
+# write to the cache other students' builds read from.
+function start_objcache() {
+  if [[ $EXECUTOR != "sandbox" ]];
+  then
+    echo "WARNING: '-C' is only used with '-e sandbox', not '-e $EXECUTOR'"
+    OBJCACHE=""
+    return
+  fi
+  mkdir -p $OBJCACHE
+  OBJCACHE=$(cd $OBJCACHE && pwd)
+  OBJCACHELOG="$OBJCACHE/run.$$.log"
+  touch $OBJCACHELOG
+  MAKEARGS="$MAKEARGS CCACHE=$TOOLS/objcache.sh"
+  CACHEENV="OBJCACHE_DIR=$OBJCACHE OBJCACHE_LOG=$OBJCACHELOG"
+  # only make can see and write the cache in the sandbox
+  MAKESANDBOX="-b $TOOLS -w $OBJCACHE"
+}
+
+# Prints the hit rate of this run's compiles.
+function stop_objcache() {
+  hits=$(grep -c '^hit' $OBJCACHELOG)
+  misses=$(grep -c '^miss' $OBJCACHELOG)
+  total=$((hits + misses))
+  echo "[ OBJCACHE ] $hits of $total objects from the cache ($(( total > 0 ? 100 * hits / total : 0 ))% hit rate), $(du -sh $OBJCACHE | cut -f1) in $OBJCACHE"
+  echo "$HWDIR,$hits,$misses" >> $RESULTS/objcache.csv
+  rm -f $OBJCACHELOG
+}
+
+# Stops the jobserver, which prints how busy its tokens were.
+function stop_jobserver() {
+  exec {JOBFD}>&-
+  kill $JOBSERVER
+  wait $JOBSERVER
+}
+
+# Copies the repro bundles of the student's failed tests to
+# results/<HW>/repro/<key>, and adds to each a rerun.sh that reruns only
+# that test, in the same kind of runner, against the build kept in
+# results/<HW>/.work/<key>. Must be called before the runner is stopped.
+function collect_repro() {
+  REPRODIR="$OUTDIR/repro/$key"
+  rm -rf $REPRODIR
+  mkdir -p $REPRODIR
+  run tar -c -C repro . 2>/dev/null | tar -x -C $REPRODIR 2>/dev/null
+  bundles=$(ls -d $REPRODIR/*/ 2>/dev/null | wc -l)
+  if [[ $bundles -eq 0 ]];
+  then
+    rm -rf $REPRODIR
+    rmdir $OUTDIR/repro 2>/dev/null
+    return
+  fi
+  echo "INFO ($key): $bundles repro bundles in $REPRODIR"
+  KEEPWORK=1
+  keep="$OUTDIR/.work/$key"
+  if [[ $EXECUTOR == "sandbox" ]];
+  then
+    rerun="$SANDBOX -d $keep/$HWDIR -l $GRADING/$HWDIR -u $keep/.overlay -- ./bin/test"
+  elif [[ $EXECUTOR == "docker" ]];
+  then
+    rerun="docker run --rm -v $keep/$HWDIR:/source $IMAGE ./bin/test"
+  else
+    rerun="./bin/test"
+  fi
+  for bundle in $REPRODIR/*/
+  do
+    {
+      echo '#!/bin/bash'
+      echo "# Reruns $(sed -n 's/^test: *//p' $bundle/repro.txt) alone"
+      echo 'mapfile -t args < "$(dirname "$0")/args"'
+      echo "cd $keep/$HWDIR && exec $rerun \"\${args[@]}\""
+    } > $bundle/rerun.sh
+    chmod +x $bundle/rerun.sh
+  done
+}
+
+function stop_runner() {
+  if [[ $EXECUTOR == "docker" ]];
+  then
+    echo "Force removing container $CONTAINERID"
+    docker rm -f $CONTAINERID
+  fi
+}
+
+# Prints every line of a student source file prefixed with the name of the
+# top-level definition (from the space separated list $2) it belongs to, or
+# with nothing if it is outside all of them.
+function tag_symbols() {
+  awk -v syms="$2" '
+    BEGIN { n = split(syms, list, " ") }
+    {
+      line = $0
+      if (owner == "" && depth == 0) {
+        for (i = 1; i <= n; i++) {
+          if (line ~ ("(^|[^A-Za-z0-9_])" list[i] "[ \t]*\\(")) {
+            owner = list[i]
+            opened = 0
+          }
+        }
+      }
+      o = gsub(/\{/, "{", line)
+      c = gsub(/\}/, "}", line)
+      print owner "\t" $0
+      depth += o - c
+      if (owner != "") {
+        if (o > 0) opened = 1
+        if ((opened && depth <= 0) || (!opened && line ~ /;/)) owner = ""
+      }
+    }' "$1"
+}
+
+# Prints a key that changes whenever the grading files, the make or test arguments, or
+# any student source in the dependency list $1 changes. A "file:symbol" entry
+# only covers that definition plus the parts of the file outside every mapped
+# definition. Student sources the dependency map never mentions count for
+# every question. Must be run from the student's homework directory.
+function question_key() {
+  deps=$1
+  {
+    cat $GRADING/$HWDIR/*
+    echo "$TESTARGS $MAKEARGS"
+    for dep in $deps $UNMAPPED; do
+      file=${dep%%:*}
+      echo "=== $dep"
+      if [[ ! -e $file ]];
+      then
+        echo "MISSING"
+      elif [[ $dep == *:* ]];
+      then
+        symbols="$(grep -v '^#' $GRADING/$HWDIR/$DEPMAP | grep -o "$file:[A-Za-z0-9_]*" | cut -d: -f2 | sort -u)"
+        tag_symbols $file "$(echo $symbols)" | awk -F'\t' -v sym="${dep#*:}" '$1 == sym || $1 == ""'
+      else
+        cat $file
+      fi
+    done
+  } | sha1sum | cut -d' ' -f1
+}
+
+# Runs the tests matching gtest filter $2 for question $1, unless its key $3
+# matches the cached one, in which case the cached grade is reused. With
+# -P, the timing tests the question declares, $4, run on the timing CPUs;
+# without $4, those of $TIMINGFILTER it has, if any.
+function run_question() {
+  question=$1
+  filter=$2
+  qkey=$3 # not $key, the student's, which the summary is written under
+  if [[ $# -ge 4 ]];
+  then
+    qtiming=$4
+    listtiming=""
+  else
+    qtiming=$TIMINGFILTER
+    listtiming=1
+  fi
+  qgrade=""
+  if [[ $qkey ]] && [[ -e $CACHEDIR/$question.grade ]] && [[ "$(cat $CACHEDIR/$question.key 2>/dev/null)" == "$qkey" ]];
+  then
+    qgrade="$(cat $CACHEDIR/$question.grade)"
+    echo "\n=== $question (cached $qgrade) ==="
+  else
+    echo "\n=== $question ==="
+    rm -f $CACHEDIR/$question.key $CACHEDIR/$question.grade
+    if [[ $PINCPUS ]];
+    then
+      LISTTIMING=$listtiming run_placed_tests "$qtiming" --gtest_filter="$filter" $TESTARGS > $CACHEDIR/$question.out
+    else
+      run_tests --gtest_filter="$filter" $TESTARGS > $CACHEDIR/$question.out
+    fi
+    qgrade="$(grep $GRADEPATTERN $CACHEDIR/$question.out | cut -d' ' -f 2)"
+    grep "^$VERSIONPATTERN" $CACHEDIR/$question.out > $CACHEDIR/$question.versions
+    sed -e "s/^$GRADEPATTERN/QUESTION_GRADE:/" -e "s/^$VERSIONPATTERN/QUESTION_$VERSIONPATTERN/" $CACHEDIR/$question.out
+    if [[ $qgrade ]];
+    then
+      echo $qgrade > $CACHEDIR/$question.grade
+      echo $qkey > $CACHEDIR/$question.key
+    fi
+  fi
+
+  if [[ $qgrade ]];
+  then
+    passed=$((passed + ${qgrade%/*}))
+    total=$((total + ${qgrade#*/}))
+    versiongrades="$versiongrades$(cat $CACHEDIR/$question.versions 2>/dev/null)
+"
+  else
+    complete=0
+  fi
+}
+
+# Runs the test binary one question at a time, rerunning only the questions
+# whose dependencies changed since the last run. The per-question grades sum to
+# the same HOMEWORK_GRADE as a single full run; if any question fails to report
+# a grade (e.g. a crash), no HOMEWORK_GRADE is printed, just like a full run.
+function run_incremental() {
+  CACHEDIR="$OUTDIR/.cache/$key"
+  mkdir -p $CACHEDIR
+  passed=0
+  total=0
+  complete=1
+  filters=""
+  versiongrades=""
+
+  # student sources that no question claims, excluding files the grading overwrites
+  mapped="$(grep -v '^#' $GRADING/$HWDIR/$DEPMAP | awk -F' %%:%% ' '{print $3}' | tr ' ' '\n' | cut -d: -f1 | sort -u)"
+  UNMAPPED=""
+  for file in $(ls *.cc *.h 2>/dev/null);
+  do
+    if ! [[ -e $GRADING/$HWDIR/$file ]] && ! echo "$mapped" | grep -qx "$file";
+    then
+      UNMAPPED="$UNMAPPED $file"
+    fi
+  done
+
+  while IFS= read -r entry <&3
+  do
+    question="$(echo "$entry" | awk -F' %%:%% ' '{print $1}')"
+    filter="$(echo "$entry" | awk -F' %%:%% ' '{print $2}')"
+    deps="$(echo "$entry" | awk -F' %%:%% ' '{print $3}')"
+    filters="$filters:$filter"
+    if [[ $TIMINGDECLARED ]];
+    then
+      run_question $question "$filter" "$(question_key "$deps")" "$(echo "$entry" | awk -F' %%:%% ' '{print $4}')"
+    else
+      run_question $question "$filter" "$(question_key "$deps")"
+    fi
+  done 3< <(grep -v '^#' $GRADING/$HWDIR/$DEPMAP | grep .)
+
+  # tests that no question claims are always rerun
+  run_question "Unmapped" "-${filters#:}" ""
+
+  if [[ $complete == 1 ]];
+  then
+    # each version's grade is the sum over the questions too
+    echo "$versiongrades" | awk -v pattern=$VERSIONPATTERN '
+      $1 == pattern {
+        if (!($2 in tests)) order[++n] = $2
+        split($3, g, "/"); passed[$2] += g[1]; tests[$2] += g[2]
+      }
+      END { for (i = 1; i <= n; i++) print pattern, order[i], passed[order[i]] "/" tests[order[i]] }'
+    echo "\n$GRADEPATTERN $passed/$total"
+  fi
+}
+
+# Grades the student at each deadline in $DUEDATE, or at their latest commit.
 function evaluate() {
   echo "\nEvaluating $1 $2 ($3)"
   lname=$(no_white_space $1)
   fname=$(no_white_space $2)
   login=$(no_white_space $3)
+  EVAL_START=$(date +%s.%N)
 
+  IFS=',' read -ra deadlines <<< "$DUEDATE"
+  if [[ ${#deadlines[@]} -eq 0 ]];
+  then
+    deadlines=("")
+  fi
+  for deadline in "${deadlines[@]}"
+  do
+    # results of a student graded at several deadlines are told apart by the deadline
+    key=$login
+    if [[ ${#deadlines[@]} -gt 1 ]];
+    then
+      key="$login@$deadline"
+    fi
+    evaluate_at "$deadline"
+  done
+
+  echo "$HWDIR,$login,$(awk -v start=$EVAL_START -v end=$(date +%s.%N) 'BEGIN {printf "%.3f", end - start}')" >> $DURATIONS
+}
+
+# Copies the files extracted in directory $1 into the kept work directory $2
+# by content. Only the files whose contents changed are written, so make sees
+# them as new whatever their commit date. The files extracted last time
+# (listed in $2/.extracted) that are gone now were deleted by the student and
+# are removed.
+function sync_extracted() {
+  (cd $1 && find . -type f | sort) > $1.files
+  if [[ -e $2/.extracted ]];
+  then
+    comm -23 $2/.extracted $1.files | while IFS= read -r file
+    do
+      rm -f "$2/$file"
+    done
+  fi
+  while IFS= read -r file
+  do
+    if ! cmp -s "$1/$file" "$2/$file";
+    then
+      mkdir -p "$(dirname "$2/$file")"
+      cp "$1/$file" "$2/$file"
+    fi
+  done < $1.files
+  mv $1.files $2/.extracted
+}
 
+# Extracts the student's homework directory as of the last commit on master
+# before deadline $1 into a work directory of its own, then builds and tests it
+# there. The clone itself is only read, so it can be shared by concurrent runs
+# and by several deadlines at once.
+function evaluate_at() {
   cd $DIR
   OUTDIR="${RESULTS}/${HWDIR}"
   mkdir -p $OUTDIR
-  OUT="${OUTDIR}/${login}.out"
+  OUT="${OUTDIR}/${key}.out"
   echo "Student : ${fname} ${lname} (${login})" #> $OUT
   echo "Github  : ${login}" #>> $OUT
   echo "Course  : ${CLASSREPO}" #>> $OUT
   echo "Homework: ${HWDIR}" #>> $OUT
   echo "\nEVALUATION:" #>> $OUT
+  STAGE_START=$(date +%s.%N)
+  STUDENTTARGET=""
+  LAYERS=""
+  grade=""
+  failure=""
+  KEEPWORK=""
 
-  # checkout code before due date
-  echo "Checking out master branch before due date $DUEDATE"
-  curr=$PWD
-  cd $STUDENTDIR/$login
-  git checkout "`git rev-list master -n 1 --first-parent --before=$DUEDATE --date=local`"
-  cd $curr
+  # extract the homework as of the due date
+  echo "Extracting $HWDIR from the last commit on master before due date $1"
+  WORKDIR="$SCRATCH/$key"
+  if [[ $CACHE == 1 ]];
+  then
+    WORKDIR="$OUTDIR/.work/$key"
+  fi
+  commit="$(git -C $STUDENTDIR/$login rev-list master -n 1 --first-parent ${1:+--before=$1} --date=local 2>/dev/null)"
+  if [[ $CACHE != 1 ]];
+  then
+    rm -rf $WORKDIR
+  fi
+  mkdir -p $WORKDIR
+  if [[ $commit ]] && [[ $CACHE == 1 ]];
+  then
+    echo "INFO ($key): commit $commit"
+    # tar dates files by the commit, which can be older than the kept build
+    rm -rf $SCRATCH/$key.extract
+    mkdir -p $SCRATCH/$key.extract
+    git -C $STUDENTDIR/$login archive $commit $HWDIR | tar -x -C $SCRATCH/$key.extract
+    sync_extracted $SCRATCH/$key.extract $WORKDIR
+    rm -rf $SCRATCH/$key.extract
+  elif [[ $commit ]];
+  then
+    echo "INFO ($key): commit $commit"
+    git -C $STUDENTDIR/$login archive $commit $HWDIR | tar -x -C $WORKDIR
+  fi
+  stage_done extract
 
-  STUDENTMAIN=$STUDENTDIR/$login/$HWDIR/main.cc
+  STUDENTMAIN=$WORKDIR/$HWDIR/main.cc
   echo $STUDENTMAIN
   if [[ -e $STUDENTMAIN ]];
   then
-    STUDENTTARGET=$STUDENTDIR/$login/$HWDIR
+    STUDENTTARGET=$WORKDIR/$HWDIR
   fi
 
-  echo "INFO ($login): $STUDENTTARGET"
+  echo "INFO ($key): $STUDENTTARGET"
 
   if [[ -e $STUDENTTARGET ]];
   then
-    echo "INFO ($login): Found homework directory $STUDENTTARGET"
+    echo "INFO ($key): Found homework directory $STUDENTTARGET"
 
     # copy all grading files to students directory
     echo "Coping grading file to $STUDENTTARGET"
     cd $STUDENTTARGET
-    cp $GRADING/$HWDIR/* .
+    if [[ $EXECUTOR == "sandbox" ]];
+    then
+      # nothing is copied: the sandbox stacks the grading files over the
+      # student's, both read-only, and keeps what the build writes in .overlay
+      LAYERS="-l $GRADING/$HWDIR -u $WORKDIR/.overlay"
+      mkdir -p $WORKDIR/.overlay
+    elif [[ $CACHE == 1 ]];
+    then
+      # keep timestamps so make only rebuilds the student files that changed
+      cp -p $GRADING/$HWDIR/* .
+    else
+      cp $GRADING/$HWDIR/* .
+    fi
+    stage_done copy
 
-    # create a new docker container
-    echo "Creating docker container..."
-    CONTAINERID="$(docker run -v $PWD:/source -di klavins/ecep520:cppenv)"
-    echo "Docker container created with id $CONTAINERID"
+    # create a new docker container, or build locally
+    if [[ $PINCPUS ]];
+    then
+      lease_cpus
+    fi
+    start_runner
+    stage_done start
 
     # does it compile?
     echo "\n=== COMPILES? ===" >> $OUT
-    echo "INFO ($login): Checking compilation"
-    docker exec $CONTAINERID make -f $MAKE spotless >> $OUT
-    docker exec $CONTAINERID make -f $MAKE >> $OUT
+    echo "INFO ($key): Checking compilation"
+    if [[ $CACHE == 1 ]];
+    then
+      run rm -f bin/test bin/fuzz
+    else
+      run make -f $MAKE spotless >> $OUT
+    fi
+    SANDBOXARGS="$MAKESANDBOX" with_token -m run env MAKEFLAGS="$MAKEJOBS" $CACHEENV make -f $MAKE $MAKEARGS >> $OUT
     failure="$(grep -i "failed" $OUT)"
+    stage_done compile
 
     # does it pass the tests
+    testsfrom=$(( $(wc -l < $OUT) + 1 ))
     echo "\n=== PASSES TESTS? ===" >> $OUT
-    echo "INFO ($login): Checking compilation"
-    docker exec $CONTAINERID ./bin/test >> $OUT
+    echo "INFO ($key): Checking compilation"
+    if [[ $CACHE == 1 ]];
+    then
+      with_token run_incremental >> $OUT
+    elif [[ $PINCPUS ]];
+    then
+      with_token run_placed_tests "$TIMINGFILTER" $TESTARGS >> $OUT
+    else
+      with_token run_tests $TESTARGS >> $OUT
+    fi
+    failure="$failure$(grep "timed out" $OUT)"
+    tail -n +$testsfrom $OUT | grep "^$VERSIONPATTERN" | while read pattern version vgrade weighted
+    do
+      echo "$fname,$lname,$key,$version,$vgrade" >> $RESULTS/versions.csv
+    done
+    stage_done test
+
+    if [[ $REPRO == 1 ]];
+    then
+      collect_repro
+      stage_done repro
+    fi
 
 
 
@@ -117,39 +831,182 @@ function evaluate() {
     # save summary of grades
     grade="$(grep -i $GRADEPATTERN $OUT | cut -d' ' -f 2)"
 
-    echo "Force removing container $CONTAINERID"
-    docker rm -f $CONTAINERID
+    stop_runner
+    if [[ $PINCPUS ]];
+    then
+      release_cpus
+    fi
+    stage_done stop
   else
-    echo "Homework directory '$STUDENTTARGET' not found!"
-    errmsg="ERROR: Homework directory $STUDENTTARGET not found"
+    echo "Homework directory '$HWDIR' not found in $STUDENTDIR/$login before '$1'!"
+    errmsg="ERROR: Homework directory $STUDENTDIR/$login/$HWDIR not found"
     failure=$errmsg
     echo $errmsg >> $OUT
   fi
 
-  echo "$fname,$lname,$login,$grade,$failure" >> $SUMMARY
+  echo "$fname,$lname,$key,$grade,$failure" >> $SUMMARY
+
+  # the extracted homework is only kept for '-c 1', whose builds reuse it,
+  # and for the reruns of repro bundles
+  cd $DIR
+  if [[ $CACHE != 1 ]] && [[ $KEEPWORK ]];
+  then
+    mkdir -p $OUTDIR/.work
+    rm -rf $OUTDIR/.work/$key
+    mv $WORKDIR $OUTDIR/.work/$key
+  elif [[ $CACHE != 1 ]];
+  then
+    rm -rf $WORKDIR
+  fi
+}
+
+# Prints "seconds,fname,lname,login" for every student in $input with the
+# seconds their grading is expected to take. A student is expected to take as long as their last run of
+# this homework, else their last run of any homework, else the mean of this
+# homework's past runs, else $DEFAULTDURATION.
+function schedule() {
+  touch $DURATIONS
+  awk -F',' -v hw=$HWDIR -v def=$DEFAULTDURATION '
+    FILENAME == ARGV[1] {
+      if ($1 == hw) { this[$2] = $3 } else { other[$2] = $3 }
+      next
+    }
+    FNR == 1 {
+      n = 0; sum = 0
+      for (l in this) { n++; sum += this[l] }
+      if (n > 0) { def = sum / n }
+    }
+    {
+      login = $3
+      gsub(/[ \t\r]/, "", login)
+      if (login == "") next
+      e = (login in this) ? this[login] : (login in other) ? other[login] : def
+      printf "%.3f,%s,%s,%s\n", e, $1, $2, login
+    }' $DURATIONS "$input"
+}
+
+# Reads expected seconds, one per line, in the order the jobs are started
+# and prints how long $1 workers take to run them all, each job going to the
+# first worker that is free.
+function makespan() {
+  awk -v workers=$1 '
+    {
+      best = 1
+      for (w = 2; w <= workers; w++) if (end[w] < end[best]) best = w
+      end[best] += $1
+    }
+    END {
+      m = 0
+      for (w = 1; w <= workers; w++) if (end[w] > m) m = end[w]
+      printf "%.0f", m
+    }'
 }
 
 ###### EVALUATION ######
 echo "***** BEGIN EVALUATION *****"
+if [[ $EXECUTOR == "sandbox" ]] || [[ $JOBS ]];
+then
+    make -s -C $TOOLS || exit 1
+fi
 if [[ $APPEND == 1 ]];
 then
     [[ -e $STUDENTDIR ]] && rm -rf $STUDENTDIR
     [[ -e $RESULTS ]] && rm -rf $RESULTS
     touch $SUMMARY
 fi
+if ! [[ -d $WORKSPACE ]];
+then
+    WORKSPACE="$RESULTS"
+fi
+SCRATCH="$WORKSPACE/grade.$$"       # work directories of this run, removed when it ends
+trap 'rm -rf $SCRATCH' EXIT
+if [[ $EVENTS ]];
+then
+    EVENTS="$(cd "$(dirname "$EVENTS")" && pwd)/$(basename "$EVENTS")"
+    if [[ $EXECUTOR == "sandbox" ]] && [[ $(dirname $EVENTS) =~ ^/(tmp)?$ ]];
+    then
+        # the sandbox mounts the socket's directory over its own
+        echo "ERROR: with '-e sandbox', put the '-L' socket in a directory of its own, e.g. /tmp/gradewatch/events.sock"
+        exit 1
+    fi
+fi
+if [[ $REPRO == 1 ]];
+then
+    TESTARGS="$TESTARGS --grade_repro=repro"
+fi
+if grep -v '^#' $GRADING/$HWDIR/$VERSIONS 2>/dev/null | grep -q .;
+then
+    TESTARGS="$TESTARGS --grade_versions=$VERSIONS"
+fi
+if [[ $JOBS ]];
+then
+    start_jobserver
+fi
+if [[ $OBJCACHE ]];
+then
+    start_objcache
+fi
+if [[ $PINCPUS ]];
+then
+    start_placement
+fi
 if [[ $input ]];
 then
     echo "Reading '${input}'"
-    while IFS=',' read fname lname login
+    inorder="$(schedule)"
+    jobs="$inorder"
+    if [[ $WORKERS -gt 1 ]];
+    then
+      # longest jobs first, so the slowest students do not start last
+      jobs="$(echo "$inorder" | sort -t',' -k1,1nr -s)"
+    fi
+    predicted=$(echo "$jobs" | cut -d',' -f1 | makespan $WORKERS)
+    fileorder=$(echo "$inorder" | cut -d',' -f1 | makespan $WORKERS)
+    echo "Grading $(echo "$jobs" | grep -c .) students with $WORKERS workers, predicted makespan ${predicted}s (${fileorder}s in file order)"
+    mkdir -p $RESULTS/$HWDIR
+    started=$(date +%s)
+    running=0
+    workers=()
+    while IFS=',' read expected fname lname login
     do
-      echo "Login $login"
-      evaluate $lname $fname $login
-    done < "$input"
+      [[ $login ]] || continue
+      echo "Login $login (expected ${expected}s)"
+      if [[ $WORKERS -gt 1 ]];
+      then
+        if [[ $running -ge $WORKERS ]];
+        then
+          wait -n
+          running=$((running - 1))
+        fi
+        # each worker logs to its own file so the console stays readable
+        evaluate $lname $fname $login > $RESULTS/$HWDIR/$login.log 2>&1 &
+        workers+=($!)
+        running=$((running + 1))
+      else
+        evaluate $lname $fname $login
+      fi
+    done <<< "$jobs"
+    # not a bare wait, which would wait for the jobserver too
+    if [[ ${#workers[@]} -gt 0 ]];
+    then
+      wait "${workers[@]}"
+    fi
+    actual=$(( $(date +%s) - started ))
+    echo "MAKESPAN: predicted ${predicted}s, actual ${actual}s with $WORKERS workers"
+    echo "$HWDIR,$WORKERS,$predicted,$actual" >> $RESULTS/makespan.csv
 else
     echo "Using single login '$login'"
     evaluate "unknown" "unknown" $login
 fi
 
+if [[ $JOBS ]];
+then
+    stop_jobserver
+fi
+if [[ $OBJCACHE ]];
+then
+    stop_objcache
+fi
 echo "***** END EVALUATION *****"
 
 echo "Don't forget to run 'docker system prune' to remove extra containers"
@@ -0,0 +1,206 @@
+#!/bin/bash
+
+# Grading daemon. Watches the student repos cloned by pull.sh for new commits
+# to the homework directory and regrades them, most recent push first.
+
+STUDENTDIR="tmp"                    # the output directory for student repos
+DIR=$PWD                            # current working directory
+RESULTS="$DIR/results"              # output directory for results
+DUEDATE=""                          # the due date of the homework
+POLL=60                             # seconds between polls of the student repos
+BATCH=""                            # if 1, queue every student once at startup
+ONCE=""                             # if 1, exit once the queue is empty
+GRADEARGS=""                        # extra arguments passed to grade.sh
+
+GRADEPATTERN="HOMEWORK_GRADE:"
+
+###### OPTIONS ######
+while getopts i:h:d:p:b:o: option
+do
+case "${option}"
+in
+i) input=${OPTARG};;    # the input file for student logins
+h) HWDIR=${OPTARG};;    # this weeks homework directory name
+d) DUEDATE=${OPTARG};;  # due date for the homework
+p) POLL=${OPTARG};;     # seconds between polls
+b) BATCH=${OPTARG};;    # if 1, grade the whole class once at startup
+o) ONCE=${OPTARG};;     # if 1, exit when there is nothing left to grade
+esac
+done
+shift $((OPTIND -1))
+GRADEARGS="$@"                      # anything after -- is passed on to grade.sh
+
+function usage() {
+    echo "Usage: bash graded.sh -h <HW_X> -i students.csv [options] [-- grade.sh options]"
+    echo "-h   Which homework you are evaluting (e.g. 'HW_1')"
+    echo "-i   Filepath of csv of all students [LAST_NAME,FIRST_NAME,GITHUB_LOGIN]"
+    echo "-d   The due date for the assignment e.g. '2019-01-21' (default: grade the latest commit)"
+    echo "-p   Seconds between polls of the student repos (default 60)"
+    echo "-b   If 1, queue every student once at startup, e.g. for a full-class run"
+    echo "-o   If 1, exit once the queue is empty instead of polling forever"
+}
+
+if ! [[ $HWDIR ]] || ! [[ $input ]];
+then
+    echo "OPPS! The arguments '-h' and '-i' are required."
+    usage
+    exit 1
+fi
+
+OUTDIR="$RESULTS/$HWDIR"
+STATE="$OUTDIR/.daemon"             # per student: last graded commit and grading logs
+QUEUE="$STATE/queue"                # "<push time> <commit time> <login> <commit>", most recent push first
+LATEST="$OUTDIR/latest.csv"         # latest grade of every student, updated after each regrade
+LOG="$OUTDIR/daemon.log"            # one line per regrade with its latency
+STATUS="$OUTDIR/daemon.status"      # queue depth and latency so far
+mkdir -p $STATE
+touch $QUEUE $LATEST
+
+###### FUNCTIONS ######
+function no_white_space() {
+    NO_WHITESPACE="$(echo "${1}" | tr -d '[:space:]')"
+    echo $NO_WHITESPACE
+}
+
+function log() {
+  echo "$(date '+%Y-%m-%d %H:%M:%S') $@" | tee -a $LOG
+}
+
+# Fetches the student's repo and prints the latest commit on master that
+# touches the homework directory, or nothing. With $DUEDATE, it is the commit
+# grade.sh grades at the last deadline instead.
+function latest_commit() {
+  repo=$STUDENTDIR/$1
+  if ! [[ -d $repo/.git ]];
+  then
+    return
+  fi
+  # grade.sh only reads the clone, so master itself can be fast-forwarded
+  git -C $repo fetch -q --update-head-ok origin +master:master 2>/dev/null
+  if [[ $DUEDATE ]];
+  then
+    commits=""
+    IFS=',' read -ra deadlines <<< "$DUEDATE"
+    for due in "${deadlines[@]}"
+    do
+      commits="$commits $(git -C $repo rev-list master -n 1 --first-parent --before=$due --date=local 2>/dev/null)"
+    done
+    # the newest of them, whatever order the deadlines are in
+    [[ ${commits// /} ]] && git -C $repo rev-list -n 1 --no-walk $commits 2>/dev/null
+  else
+    git -C $repo rev-list -n 1 master -- $HWDIR 2>/dev/null
+  fi
+}
+
+# Queues student $1 at commit $2, replacing any older commit of theirs. The
+# push time is when the commit was first seen, so a backdated commit still
+# counts as a new push. Students seen in the same poll are ordered by commit time.
+function enqueue() {
+  login=$1
+  commit=$2
+  committed=$(git -C $STUDENTDIR/$login log -1 --format=%ct $commit)
+  {
+    awk -v l=$login '$3 != l' $QUEUE
+    echo "$(date +%s) $committed $login $commit"
+  } | sort -k1,1nr -k2,2nr > $QUEUE.tmp
+  mv $QUEUE.tmp $QUEUE
+}
+
+# Queues every student whose homework has a commit that was not graded yet,
+# or every student with a commit if $1 is 1.
+function poll() {
+  LASTPOLL=$(date +%s)
+  while IFS=',' read fname lname login
+  do
+    login=$(no_white_space $login)
+    [[ $login ]] || continue
+    commit="$(latest_commit $login)"
+    if ! [[ $commit ]];
+    then
+      continue
+    fi
+    if [[ $1 == 1 ]] || [[ "$(cat $STATE/$login.commit 2>/dev/null)" != "$commit" ]];
+    then
+      if ! grep -q " $login $commit\$" $QUEUE;
+      then
+        enqueue $login $commit
+      fi
+    fi
+  done < "$input"
+}
+
+# Replaces the student's line in $LATEST with their newest summary line.
+function publish() {
+  login=$1
+  line="$(grep ",$login," $RESULTS/summary.csv | tail -1)"
+  {
+    grep -v ",$login," $LATEST
+    echo "$line"
+  } > $LATEST.tmp
+  mv $LATEST.tmp $LATEST
+}
+
+# Grades the student at the head of the queue.
+function grade_next() {
+  read pushed committed login commit < $QUEUE
+  sed -i 1d $QUEUE
+
+  started=$(date +%s)
+  grep ",$login\$" $input | head -1 > $STATE/$login.csv
+  bash $DIR/grade.sh -h $HWDIR -i $STATE/$login.csv ${DUEDATE:+-d $DUEDATE} $GRADEARGS > $STATE/$login.log 2>&1
+  finished=$(date +%s)
+  echo $commit > $STATE/$login.commit
+  publish $login
+
+  grade="$(grep $GRADEPATTERN $OUTDIR/$login.out | tail -1 | cut -d' ' -f 2)"
+  depth=$(grep -c . $QUEUE)
+  log "graded $login ${commit:0:8} grade=${grade:-none} queue=$depth wait=$((started - pushed))s latency=$((finished - pushed))s"
+  echo "$((finished - pushed))" >> $STATE/latencies
+}
+
+function report_status() {
+  depth=$(grep -c . $QUEUE)
+  {
+    echo "queue_depth $depth"
+    echo "updated $(date '+%Y-%m-%d %H:%M:%S')"
+    sort -n $STATE/latencies 2>/dev/null | awk '
+      { x[NR] = $1; sum += $1 }
+      END {
+        if (NR == 0) exit
+        printf "graded %d\nlatency_mean %.0f\nlatency_p50 %d\nlatency_p90 %d\nlatency_max %d\n",
+               NR, sum / NR, x[int((NR - 1) * 0.5) + 1], x[int((NR - 1) * 0.9) + 1], x[NR]
+      }'
+  } > $STATUS
+}
+
+###### DAEMON ######
+trap 'log "stopped"; exit 0' INT TERM
+LASTPOLL=0
+log "watching $HWDIR for $(grep -c . $input) students every ${POLL}s"
+if [[ $BATCH == 1 ]];
+then
+    poll 1
+    log "queued $(grep -c . $QUEUE) students for a batch run"
+fi
+
+while true
+do
+    if [[ $(( $(date +%s) - LASTPOLL )) -ge $POLL ]];
+    then
+        poll
+    fi
+    report_status
+    if [[ -s $QUEUE ]];
+    then
+        grade_next
+        report_status
+        continue
+    fi
+    if [[ $ONCE == 1 ]];
+    then
+        log "queue empty"
+        break
+    fi
+    wait=$(( POLL - ($(date +%s) - LASTPOLL) ))
+    sleep $(( wait > 0 ? wait : 0 ))
+done
@@ -0,0 +1,139 @@
+// Heap allocation counting for alloc_counter.h.
+//
+// With GRADE_COUNT_ALLOCS, MakefileGrade links with
+// -Wl,--wrap=malloc,--wrap=free,--wrap=calloc,--wrap=realloc so every call to
+// these from the test program's own objects (student code included) goes
+// through the __wrap_ functions below. operator new and delete are replaced
+// with versions built on malloc and free, so C++ allocations, including those
+// made inside the standard library, are counted too.
+
+#include "alloc_counter.h"
+
+#ifdef GRADE_COUNT_ALLOCS
+
+#include <malloc.h>
+#include <stdlib.h>
+#include <atomic>
+#include <new>
+
+static std::atomic<long> alloc_count(0);
+static std::atomic<long> alloc_bytes(0);
+static std::atomic<long> live_bytes(0);
+static std::atomic<long> peak_bytes(0);
+
+static void note_alloc(void* p) {
+    if (p == NULL) {
+        return;
+    }
+    long size = malloc_usable_size(p);
+    alloc_count++;
+    alloc_bytes += size;
+    long live = live_bytes += size;
+    long peak = peak_bytes;
+    while (live > peak && !peak_bytes.compare_exchange_weak(peak, live)) {
+    }
+}
+
+static void note_free(void* p) {
+    if (p != NULL) {
+        live_bytes -= malloc_usable_size(p);
+    }
+}
+
+extern "C" {
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* p, size_t size);
+void __real_free(void* p);
+
+void* __wrap_malloc(size_t size) {
+    void* p = __real_malloc(size);
+    note_alloc(p);
+    return p;
+}
+
+void* __wrap_calloc(size_t n, size_t size) {
+    void* p = __real_calloc(n, size);
+    note_alloc(p);
+    return p;
+}
+
+void* __wrap_realloc(void* p, size_t size) {
+    note_free(p);
+    void* q = __real_realloc(p, size);
+    note_alloc(q != NULL ? q : p);
+    return q;
+}
+
+void __wrap_free(void* p) {
+    note_free(p);
+    __real_free(p);
+}
+
+}
+
+void* operator new(size_t size) {
+    void* p = malloc(size > 0 ? size : 1);
+    if (p == NULL) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    free(p);
+}
+
+bool AllocationCounter::enabled() {
+    return true;
+}
+
+AllocationCounter::Totals AllocationCounter::totals() {
+    return {alloc_count, alloc_bytes, live_bytes, peak_bytes};
+}
+
+long AllocationCounter::reset_peak() {
+    return peak_bytes.exchange(live_bytes);
+}
+
+void AllocationCounter::restore_peak(long peak) {
+    long current = peak_bytes;
+    while (peak > current && !peak_bytes.compare_exchange_weak(current, peak)) {
+    }
+}
+
+#else
+
+bool AllocationCounter::enabled() {
+    return false;
+}
+
+AllocationCounter::Totals AllocationCounter::totals() {
+    return {0, 0, 0, 0};
+}
+
+long AllocationCounter::reset_peak() {
+    return 0;
+}
+
+void AllocationCounter::restore_peak(long peak) {
+}
+
+#endif
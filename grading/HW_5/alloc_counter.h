@@ -0,0 +1,108 @@
+// Opt-in counting of the heap allocations made by each test.
+
+#ifndef ECE590_ALLOC_COUNTER_H
+#define ECE590_ALLOC_COUNTER_H
+
+#include <gtest/gtest.h>
+
+/*
+ * Allocations made over some span of a test.
+ */
+struct AllocationStats {
+    long count = 0;     // calls to operator new, malloc, calloc and realloc
+    long bytes = 0;     // total bytes allocated
+    long peak_live = 0; // most bytes allocated and not yet freed at any one time
+};
+
+/*
+ * Counts the heap allocations of the test program. Only compiled in when
+ * building with "make -f MakefileGrade ALLOC=1", which defines
+ * GRADE_COUNT_ALLOCS and links malloc, calloc, realloc and free through the
+ * wrappers in alloc_counter.cc. Otherwise enabled() is false and every
+ * stat is 0.
+ */
+class AllocationCounter {
+public:
+
+    /*
+     * Running totals since the program started.
+     */
+    struct Totals {
+        long count;
+        long bytes;
+        long live; // bytes allocated and not yet freed
+        long peak; // highest "live" since the last reset_peak()
+    };
+
+    static bool enabled();
+
+    static Totals totals();
+
+    /*!
+     * Start tracking the peak from the current live bytes.
+     * @return the peak before the reset
+     */
+    static long reset_peak();
+
+    /*!
+     * Put back a peak returned by reset_peak() if it is higher.
+     * @param peak
+     */
+    static void restore_peak(long peak);
+
+    /*!
+     * Stats of the last test body, recorded by Question for the listener.
+     */
+    static AllocationStats& test_stats() {
+        static AllocationStats stats;
+        return stats;
+    }
+};
+
+/*
+ * Measures the allocations made between its construction and stop().
+ * Scopes may be nested.
+ */
+class AllocationScope {
+public:
+    AllocationScope() : start(AllocationCounter::totals()), outer_peak(AllocationCounter::reset_peak()) {}
+
+    ~AllocationScope() {
+        stop();
+    }
+
+    AllocationStats stop() {
+        if (!stopped) {
+            AllocationCounter::Totals now = AllocationCounter::totals();
+            result.count = now.count - start.count;
+            result.bytes = now.bytes - start.bytes;
+            result.peak_live = now.peak - start.live;
+            AllocationCounter::restore_peak(outer_peak);
+            stopped = true;
+        }
+        return result;
+    }
+
+private:
+    AllocationCounter::Totals start;
+    long outer_peak;
+    bool stopped = false;
+    AllocationStats result;
+};
+
+/*
+ * Fails if "statement" allocates more than "max" times. Does nothing
+ * when allocation counting is not compiled in.
+ */
+#define EXPECT_ALLOCATIONS_AT_MOST(statement, max) \
+    do { \
+        AllocationScope gtest_alloc_scope; \
+        statement; \
+        AllocationStats gtest_alloc_stats = gtest_alloc_scope.stop(); \
+        if (AllocationCounter::enabled()) { \
+            EXPECT_LE(gtest_alloc_stats.count, (long) (max)) \
+                << #statement << " allocated " << gtest_alloc_stats.bytes << " bytes"; \
+        } \
+    } while (0)
+
+#endif //ECE590_ALLOC_COUNTER_H
@@ -0,0 +1,46 @@
+// Answer keys read from files such as AnswerMap.txt.
+
+#ifndef ECE590_ANSWER_KEY_H
+#define ECE590_ANSWER_KEY_H
+
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+
+#define ANSWERDELIM " %%:%% " // separates a key from its value in an answer key file
+
+/*
+ * Answer keys of "<key> %%:%% <count>" lines, read once per path and kept
+ * for the life of the process.
+ */
+class AnswerKeys {
+public:
+
+    /*!
+     * The answer key at "path", read on first use.
+     */
+    static const std::map<std::string, int>& load(const std::string& path) {
+        static std::map<std::string, std::map<std::string, int>> keys;
+        auto found = keys.find(path);
+        if (found != keys.end()) {
+            return found->second;
+        }
+
+        std::cout << "loading " << path << std::endl;
+        std::ifstream infile(path);
+        std::string line;
+        std::map<std::string, int>& m = keys[path];
+        while (std::getline(infile, line)) {
+            size_t n = line.find(ANSWERDELIM);
+            if (n != std::string::npos) {
+                std::string delim = ANSWERDELIM;
+                m[line.substr(0, n)] = std::stoi(line.substr(n + delim.size()));
+            }
+        }
+        std::cout << m.size() << "!\n";
+        return m;
+    }
+};
+
+#endif //ECE590_ANSWER_KEY_H
@@ -0,0 +1,326 @@
+// Repeated, robust timing of student code against a reference.
+
+#ifndef ECE590_BENCHMARK_H
+#define ECE590_BENCHMARK_H
+
+#include <math.h>
+#include <sched.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+
+/*
+ * Robust statistics of repeated timings, over the samples left once
+ * outliers are rejected.
+ */
+struct BenchmarkSamples {
+    std::vector<double> values; // kept samples, sorted
+    int outliers = 0;           // samples rejected as too far from the median
+    double median = 0;
+    double mad = 0;             // median absolute deviation from the median
+    double low = 0;             // ~95% confidence interval of the median
+    double high = 0;
+
+    /*!
+     * Reject the samples more than "outlier_mads" scaled MADs (about
+     * standard deviations, for normal noise) from the median, then
+     * summarize the rest. The confidence interval of the median is taken
+     * from the order statistics, so it holds whatever the noise looks like.
+     */
+    static BenchmarkSamples of(std::vector<double> samples, double outlier_mads) {
+        BenchmarkSamples s;
+        std::sort(samples.begin(), samples.end());
+        double median = median_of(samples);
+        double spread = 1.4826 * mad_of(samples, median);
+        for (double x : samples) {
+            if (spread > 0 && fabs(x - median) > outlier_mads * spread) {
+                s.outliers++;
+            } else {
+                s.values.push_back(x);
+            }
+        }
+        if (s.values.empty()) {
+            return s;
+        }
+        s.median = median_of(s.values);
+        s.mad = mad_of(s.values, s.median);
+        int n = s.values.size();
+        int low = (int) floor((n - 1.96 * sqrt(n)) / 2);
+        int high = (int) ceil((n + 1.96 * sqrt(n)) / 2);
+        s.low = s.values[std::max(low, 0)];
+        s.high = s.values[std::min(high, n - 1)];
+        return s;
+    }
+
+private:
+
+    static double median_of(const std::vector<double>& sorted) {
+        size_t n = sorted.size();
+        if (n == 0) {
+            return 0;
+        }
+        return n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+    }
+
+    static double mad_of(const std::vector<double>& sorted, double median) {
+        std::vector<double> deviations;
+        for (double x : sorted) {
+            deviations.push_back(fabs(x - median));
+        }
+        std::sort(deviations.begin(), deviations.end());
+        return median_of(deviations);
+    }
+};
+
+/*
+ * One benchmark: ns per run of the measured code and, for a comparison,
+ * of the reference and the ratio between the two.
+ */
+struct BenchmarkResult {
+    std::string name;
+    long iterations = 0;         // runs per sample of the measured code
+    BenchmarkSamples ns;         // ns per run of the measured code
+    bool compared = false;       // whether there is a reference
+    BenchmarkSamples reference;  // ns per run of the reference
+    BenchmarkSamples ratio;      // measured over reference, per pair of samples
+    std::string frequency;       // signs of CPU frequency scaling, or ""
+
+    std::string describe() const {
+        std::ostringstream out;
+        out << name << ": " << ns.median << " ns/run (MAD " << percent(ns.mad, ns.median) << "%, "
+            << ns.values.size() << " samples of " << iterations << " runs, " << ns.outliers << " outliers)";
+        if (compared) {
+            out << ", " << ratio.median << "x the reference (95% CI " << ratio.low << "x to " << ratio.high
+                << "x, reference " << reference.median << " ns/run)";
+        }
+        if (!frequency.empty()) {
+            out << "; " << frequency;
+        }
+        return out.str();
+    }
+
+private:
+
+    static int percent(double part, double whole) {
+        return whole > 0 ? (int) round(100 * part / whole) : 0;
+    }
+};
+
+/*
+ * Times a function many times over and summarizes the timings robustly.
+ *
+ * The function is first run untimed for "warmup_ms", to fill the caches and
+ * let the CPU reach its working clock. Meanwhile the number of runs per
+ * sample doubles until a sample takes at least "sample_ms", so that the
+ * clock's resolution and the loop are negligible. Samples are then taken
+ * until "budget_ms" is spent, with at least "min_samples" and at most
+ * "max_samples" of them. The result is the median and MAD of the ns per
+ * run, after rejecting outliers such as a sample interrupted by another
+ * process.
+ *
+ * compare() times a reference the same way, alternating student and
+ * reference samples, so any slow stretch of the machine hits both. Each
+ * pair of samples gives a ratio, and the median ratio comes with a
+ * confidence interval.
+ *
+ * A fixed spin loop is timed before and after the samples. If its speed
+ * changed by more than "max_drift", the CPU clock changed under the
+ * benchmark. Then the samples are taken once more, and the change is
+ * reported if it happens again. A cpufreq governor other than
+ * "performance" is reported too.
+ */
+class Benchmark {
+public:
+    double warmup_ms = 20;
+    double sample_ms = 2;
+    int min_samples = 15;
+    int max_samples = 200;
+    double budget_ms = 500;
+    double outlier_mads = 3.5;
+    double max_drift = 0.1;
+
+    /*!
+     * Time "run", a void() function.
+     */
+    template <typename Run>
+    BenchmarkResult measure(const std::string& name, Run run) const {
+        return sample(name, run, run, false);
+    }
+
+    /*!
+     * Time "run" and "reference", both void() functions doing the same work.
+     */
+    template <typename Run, typename Reference>
+    BenchmarkResult compare(const std::string& name, Run run, Reference reference) const {
+        return sample(name, run, reference, true);
+    }
+
+    /*!
+     * Keep the compiler from optimizing away a result that is never used.
+     */
+    template <typename T>
+    static void keep(T& value) {
+        asm volatile("" : : "g"(&value) : "memory");
+    }
+
+    /*!
+     * Results of the current test, recorded with record() and logged by
+     * the listener once the test ends.
+     */
+    static std::vector<BenchmarkResult>& test_results() {
+        static std::vector<BenchmarkResult> results;
+        return results;
+    }
+
+    /*!
+     * Keep "result" for the listener and as test properties.
+     */
+    static void record(const BenchmarkResult& result) {
+        test_results().push_back(result);
+        std::ostringstream ns;
+        ns << result.ns.median;
+        ::testing::Test::RecordProperty(result.name + "_ns", ns.str());
+        if (result.compared) {
+            std::ostringstream ratio;
+            ratio << result.ratio.median;
+            ::testing::Test::RecordProperty(result.name + "_ratio", ratio.str());
+        }
+    }
+
+private:
+
+    template <typename Run>
+    static double time_ns(Run& run, long iterations) {
+        auto start = std::chrono::steady_clock::now();
+        for (long i = 0; i < iterations; i++) {
+            run();
+        }
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count() / iterations;
+    }
+
+    /*!
+     * Warm "run" up and return how many runs make a sample.
+     */
+    template <typename Run>
+    long calibrate(Run& run) const {
+        long iterations = 1;
+        auto start = std::chrono::steady_clock::now();
+        while (true) {
+            double sample = time_ns(run, iterations) * iterations;
+            std::chrono::duration<double, std::milli> spent = std::chrono::steady_clock::now() - start;
+            if (sample < sample_ms * 1e6 && iterations < (1L << 30)) {
+                iterations *= 2;
+            } else if (spent.count() >= warmup_ms) {
+                return iterations;
+            }
+        }
+    }
+
+    template <typename Run, typename Reference>
+    BenchmarkResult sample(const std::string& name, Run& run, Reference& reference, bool compared) const {
+        BenchmarkResult result;
+        result.name = name;
+        result.compared = compared;
+        result.iterations = calibrate(run);
+        long reference_iterations = compared ? calibrate(reference) : 0;
+
+        for (int attempt = 0; attempt < 2; attempt++) {
+            std::vector<double> runs, references, ratios;
+            double speed = spin_ns();
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < max_samples; i++) {
+                std::chrono::duration<double, std::milli> spent = std::chrono::steady_clock::now() - start;
+                if (i >= min_samples && spent.count() >= budget_ms) {
+                    break;
+                }
+                if (!compared) {
+                    runs.push_back(time_ns(run, result.iterations));
+                    continue;
+                }
+                // alternate which goes first, in case going second is faster
+                double ns, ref_ns;
+                if (i % 2) {
+                    ref_ns = time_ns(reference, reference_iterations);
+                    ns = time_ns(run, result.iterations);
+                } else {
+                    ns = time_ns(run, result.iterations);
+                    ref_ns = time_ns(reference, reference_iterations);
+                }
+                runs.push_back(ns);
+                references.push_back(ref_ns);
+                ratios.push_back(ns / ref_ns);
+            }
+            double drift = spin_ns() / speed - 1;
+
+            result.ns = BenchmarkSamples::of(runs, outlier_mads);
+            result.reference = BenchmarkSamples::of(references, outlier_mads);
+            result.ratio = BenchmarkSamples::of(ratios, outlier_mads);
+            result.frequency = "";
+            if (fabs(drift) > max_drift) {
+                std::ostringstream out;
+                out << "the clock ran " << (int) round(100 * fabs(drift)) << "% "
+                    << (drift > 0 ? "slower" : "faster") << " after the samples than before";
+                result.frequency = out.str();
+                continue;
+            }
+            break;
+        }
+
+        std::string governor = cpufreq_governor();
+        if (!governor.empty() && governor != "performance") {
+            result.frequency += (result.frequency.empty() ? "" : ", ") + ("cpufreq governor " + governor);
+        }
+        return result;
+    }
+
+    /*!
+     * ns taken by a fixed chain of dependent multiplications, the fastest
+     * of a few tries, which only changes with the CPU's clock.
+     */
+    static double spin_ns() {
+        double fastest = HUGE_VAL;
+        for (int t = 0; t < 5; t++) {
+            unsigned x = 1;
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < 200000; i++) {
+                x = x * 1664525u + 1013904223u;
+                asm volatile("" : "+r"(x));
+            }
+            std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+            fastest = std::min(fastest, elapsed.count());
+        }
+        return fastest;
+    }
+
+    /*!
+     * Governor of the CPU this runs on, or "" where cpufreq is not exposed,
+     * e.g. in most virtual machines.
+     */
+    static std::string cpufreq_governor() {
+        std::ifstream in("/sys/devices/system/cpu/cpu" + std::to_string(sched_getcpu()) +
+                         "/cpufreq/scaling_governor");
+        std::string governor;
+        in >> governor;
+        return governor;
+    }
+};
+
+/*
+ * Passes unless "result", from Benchmark::compare(), shows that the code
+ * is more than "percent" percent slower than the reference: only the lower
+ * end of the ratio's confidence interval must be within it, so noise alone
+ * does not fail a test.
+ */
+#define EXPECT_WITHIN_PERCENT_OF_REFERENCE(result, percent) \
+    do { \
+        const BenchmarkResult& gtest_bench = (result); \
+        EXPECT_LE(gtest_bench.ratio.low, 1 + (percent) / 100.0) << gtest_bench.describe() \
+                << ", expected at most " << (percent) << "% slower than the reference"; \
+    } while (0)
+
+#endif //ECE590_BENCHMARK_H
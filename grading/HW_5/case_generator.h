@@ -0,0 +1,152 @@
+// Seeded, budgeted generation of test parameters.
+
+#ifndef ECE590_CASE_GENERATOR_H
+#define ECE590_CASE_GENERATOR_H
+
+#include <math.h>
+#include <iostream>
+#include <map>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+/*
+ * Draws unique parameter tuples for a parameterized test from a seeded
+ * distribution until a question's time budget is spent.
+ *
+ * The budget is spent against an estimated cost per case (in ms) rather than
+ * the wall clock. That way the same seed always produces the same cases, and so
+ * the same test names and HOMEWORK_GRADE, no matter how loaded the machine is.
+ *
+ * Generation happens when Google Test registers the parameterized tests, so the
+ * seed and budget scale must be set before InitGoogleTest.
+ */
+class CaseGenerator {
+public:
+
+    /*
+     * Random source handed to the draw functions. Only uses the raw mt19937
+     * output so the same seed draws the same cases with any standard library.
+     */
+    class Random {
+    public:
+        explicit Random(unsigned seed) : engine(seed) {}
+
+        /*!
+         * Integer in [lo, hi]
+         */
+        int uniform(int lo, int hi) {
+            return lo + (int) (engine() % (unsigned) (hi - lo + 1));
+        }
+
+        /*!
+         * Integer in [lo, hi], where each power of two is equally likely,
+         * so small and large sizes are drawn about as often.
+         */
+        int log_uniform(int lo, int hi) {
+            double u = engine() / 4294967296.0;
+            double x = exp(log(lo + 1.0) + u * (log(hi + 1.0) - log(lo + 1.0))) - 1.0;
+            return std::min(hi, std::max(lo, (int) x));
+        }
+
+        /*!
+         * True with probability p
+         */
+        bool chance(double p) {
+            return engine() / 4294967296.0 < p;
+        }
+
+        /*!
+         * One of the given values
+         */
+        template <typename T>
+        T pick(const std::vector<T>& values) {
+            return values[engine() % values.size()];
+        }
+
+    private:
+        std::mt19937 engine;
+    };
+
+    static unsigned& seed() {
+        static unsigned seed = 520;
+        return seed;
+    }
+
+    /*!
+     * Multiplies every budget, e.g. 0.1 for a quick run.
+     */
+    static double& budget_scale() {
+        static double scale = 1.0;
+        return scale;
+    }
+
+    /*!
+     * Draw cases for the test "name" of "question" until "budget_ms" is spent.
+     *
+     * @param question question the cases count toward
+     * @param name parameterized test the cases are for
+     * @param budget_ms time budget, before scaling
+     * @param draw Case draw(Random&)
+     * @param cost double cost(const Case&), estimated ms to run every test of one case
+     * @return unique cases, in the order they were drawn
+     */
+    template <typename Case, typename Draw, typename Cost>
+    static std::vector<Case> generate(const std::string& question, const std::string& name,
+                                      double budget_ms, Draw draw, Cost cost) {
+        const int max_misses = 200; // consecutive duplicates or over-budget draws before giving up
+        double budget = budget_ms * budget_scale();
+        double spent = 0;
+        Random random(seed() ^ hash(name));
+        std::set<Case> seen;
+        std::vector<Case> cases;
+        for (int misses = 0; misses < max_misses; ) {
+            Case c = draw(random);
+            double c_cost = cost(c);
+            if (seen.count(c) || spent + c_cost > budget) {
+                misses++;
+                continue;
+            }
+            misses = 0;
+            seen.insert(c);
+            cases.push_back(c);
+            spent += c_cost;
+        }
+
+        coverage()[question] += cases.size();
+        std::cout << "[ GENERATE ] " << question << " " << name << ": " << cases.size()
+                  << " cases, ~" << (int) spent << " of " << (int) budget << " ms (seed "
+                  << seed() << ")" << std::endl;
+        return cases;
+    }
+
+    /*!
+     * Print how many generated cases each question covers.
+     */
+    static void report() {
+        for (auto& q : coverage()) {
+            std::cout << "[ GENERATE ] " << q.first << " covered " << q.second << " cases" << std::endl;
+        }
+    }
+
+private:
+
+    static std::map<std::string, int>& coverage() {
+        static std::map<std::string, int> coverage;
+        return coverage;
+    }
+
+    /*!
+     * FNV-1a, so each test gets its own stream of cases from one seed.
+     */
+    static unsigned hash(const std::string& s) {
+        unsigned h = 2166136261u;
+        for (char c : s) {
+            h = (h ^ (unsigned char) c) * 16777619u;
+        }
+        return h;
+    }
+};
+
+#endif //ECE590_CASE_GENERATOR_H
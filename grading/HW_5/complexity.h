@@ -0,0 +1,160 @@
+// Empirical time complexity of student functions.
+
+#ifndef ECE590_COMPLEXITY_H
+#define ECE590_COMPLEXITY_H
+
+#include <math.h>
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+
+/*
+ * Growth classes that can be fitted, from best to worst.
+ */
+enum ComplexityClass {
+    LINEAR,
+    N_LOG_N,
+    QUADRATIC,
+    NUM_COMPLEXITY_CLASSES
+};
+
+inline const char* complexity_name(ComplexityClass c) {
+    static const char* names[] = {"n", "n log n", "n^2"};
+    return names[c];
+}
+
+/*
+ * Result of fitting timings to each growth class.
+ */
+struct ComplexityFit {
+    std::vector<int> sizes;
+    std::vector<double> seconds;                // fastest run at each size
+    double error[NUM_COMPLEXITY_CLASSES] = {};  // rms relative error of each model
+    ComplexityClass best = LINEAR;              // model with the least error
+
+    std::string describe() const {
+        std::ostringstream out;
+        out << complexity_name(best) << " (rms error";
+        for (int c = 0; c < NUM_COMPLEXITY_CLASSES; c++) {
+            out << (c ? ", " : " ") << complexity_name((ComplexityClass) c) << ": " << error[c];
+        }
+        out << "; n = " << sizes.front() << " to " << sizes.back() << ")";
+        return out.str();
+    }
+};
+
+/*
+ * Times a function at geometrically increasing sizes and fits
+ * t(n) = a * f(n) for f in n, n log n and n^2.
+ *
+ * Each size is run several times and the fastest run kept, which is the
+ * timing least disturbed by the rest of the machine. Runs slower than
+ * "max_run_ms" are not repeated. Sizes double from "min_n" until a run takes
+ * longer than "max_run_ms", "max_n" is reached or the "budget_ms" is spent,
+ * but at least "min_sizes" sizes are always timed so that a quadratic
+ * function still gets a fit.
+ *
+ * The models are fitted by least squares on the relative error, so every size
+ * counts the same however long it took.
+ */
+class Complexity {
+public:
+    int min_n = 1024;
+    int max_n = 1 << 18;
+    int min_sizes = 4;
+    int min_runs = 3;
+    int max_runs = 50;
+    double min_size_ms = 10;  // run each size at least this long in total
+    double max_run_ms = 50;
+    double budget_ms = 1500;
+
+    /*!
+     * Time "run" at increasing sizes and fit the growth classes.
+     *
+     * @param setup State setup(int n), builds a fresh input of size n; not timed
+     * @param run void run(State&), the code being measured
+     * @return
+     */
+    template <typename Setup, typename Run>
+    ComplexityFit measure(Setup setup, Run run) const {
+        ComplexityFit fit;
+        double spent_ms = 0;
+        for (int n = min_n; ; n *= 2) {
+            double size_ms = 0, fastest = HUGE_VAL;
+            for (int i = 0; i < max_runs && (i < min_runs || size_ms < min_size_ms); i++) {
+                auto state = setup(n);
+                auto start = std::chrono::steady_clock::now();
+                run(state);
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                fastest = std::min(fastest, elapsed.count());
+                size_ms += elapsed.count() * 1000;
+                if (elapsed.count() * 1000 > max_run_ms) {
+                    break; // too slow for noise to matter
+                }
+            }
+            spent_ms += size_ms;
+            fit.sizes.push_back(n);
+            fit.seconds.push_back(fastest);
+
+            bool enough = (int) fit.sizes.size() >= min_sizes;
+            if (enough && (fastest * 1000 > max_run_ms || 2 * n > max_n || spent_ms > budget_ms)) {
+                break;
+            }
+        }
+
+        for (int c = 0; c < NUM_COMPLEXITY_CLASSES; c++) {
+            fit.error[c] = model_error(fit, (ComplexityClass) c);
+            if (fit.error[c] < fit.error[fit.best]) {
+                fit.best = (ComplexityClass) c;
+            }
+        }
+        return fit;
+    }
+
+private:
+
+    static double model(ComplexityClass c, double n) {
+        switch (c) {
+            case LINEAR: return n;
+            case N_LOG_N: return n * log2(n);
+            default: return n * n;
+        }
+    }
+
+    /*!
+     * Rms relative error of the best fitting t = a * f(n).
+     */
+    static double model_error(const ComplexityFit& fit, ComplexityClass c) {
+        // minimizing sum((a * f / t - 1)^2) gives a = sum(f / t) / sum((f / t)^2)
+        double sum_r = 0, sum_r2 = 0;
+        for (size_t i = 0; i < fit.sizes.size(); i++) {
+            double r = model(c, fit.sizes[i]) / fit.seconds[i];
+            sum_r += r;
+            sum_r2 += r * r;
+        }
+        double a = sum_r / sum_r2, error = 0;
+        for (size_t i = 0; i < fit.sizes.size(); i++) {
+            double e = a * model(c, fit.sizes[i]) / fit.seconds[i] - 1;
+            error += e * e;
+        }
+        return sqrt(error / fit.sizes.size());
+    }
+};
+
+/*
+ * Passes if the fitted growth class is no worse than "expected". The fit and
+ * timings are printed and recorded as test properties.
+ */
+#define EXPECT_COMPLEXITY_AT_MOST(fit, expected) \
+    do { \
+        const ComplexityFit& gtest_fit = (fit); \
+        std::cout << "[ COMPLEXITY ] " << gtest_fit.describe() << std::endl; \
+        ::testing::Test::RecordProperty("complexity", complexity_name(gtest_fit.best)); \
+        EXPECT_LE(gtest_fit.best, (expected)) << "Grows like " << gtest_fit.describe() \
+                << ", expected " << complexity_name(expected) << " or better"; \
+    } while (0)
+
+#endif //ECE590_COMPLEXITY_H
@@ -0,0 +1,131 @@
+// Matrix element type that counts its copies and moves.
+
+#ifndef ECE590_COUNTED_H
+#define ECE590_COUNTED_H
+
+#include <iostream>
+
+/*
+ * A double that counts how it is constructed, copied, moved and assigned,
+ * for grading the value semantics of containers such as TypedMatrix.
+ * It converts implicitly from double so that code like ElementType() or
+ * "ElementType sum = 0;" keeps compiling, and supports the arithmetic
+ * and comparison operators a matrix of doubles needs.
+ */
+class Counted {
+public:
+
+    /*
+     * Totals since the last reset().
+     */
+    struct Counts {
+        long constructed = 0;   // default or from a double
+        long copied = 0;        // copy constructed
+        long moved = 0;         // move constructed
+        long copy_assigned = 0;
+        long move_assigned = 0;
+
+        /*!
+         * Element copies made, by construction or assignment.
+         */
+        long copies() const {
+            return copied + copy_assigned;
+        }
+    };
+
+    static Counts& counts() {
+        static Counts counts;
+        return counts;
+    }
+
+    static void reset() {
+        counts() = Counts();
+    }
+
+    double value;
+
+    Counted() : value(0) {
+        counts().constructed++;
+    }
+
+    Counted(double value) : value(value) {
+        counts().constructed++;
+    }
+
+    Counted(const Counted& other) : value(other.value) {
+        counts().copied++;
+    }
+
+    Counted(Counted&& other) noexcept : value(other.value) {
+        counts().moved++;
+    }
+
+    Counted& operator=(const Counted& other) {
+        value = other.value;
+        counts().copy_assigned++;
+        return *this;
+    }
+
+    Counted& operator=(Counted&& other) noexcept {
+        value = other.value;
+        counts().move_assigned++;
+        return *this;
+    }
+
+    explicit operator double() const {
+        return value;
+    }
+
+    Counted& operator+=(const Counted& other) {
+        value += other.value;
+        return *this;
+    }
+
+    Counted& operator-=(const Counted& other) {
+        value -= other.value;
+        return *this;
+    }
+
+    Counted& operator*=(const Counted& other) {
+        value *= other.value;
+        return *this;
+    }
+
+    Counted operator-() const {
+        return Counted(-value);
+    }
+
+    friend Counted operator+(const Counted& a, const Counted& b) {
+        return Counted(a.value + b.value);
+    }
+
+    friend Counted operator-(const Counted& a, const Counted& b) {
+        return Counted(a.value - b.value);
+    }
+
+    friend Counted operator*(const Counted& a, const Counted& b) {
+        return Counted(a.value * b.value);
+    }
+
+    friend bool operator==(const Counted& a, const Counted& b) {
+        return a.value == b.value;
+    }
+
+    friend bool operator!=(const Counted& a, const Counted& b) {
+        return a.value != b.value;
+    }
+
+    friend bool operator<(const Counted& a, const Counted& b) {
+        return a.value < b.value;
+    }
+
+    friend bool operator>(const Counted& a, const Counted& b) {
+        return a.value > b.value;
+    }
+
+    friend std::ostream& operator<<(std::ostream& out, const Counted& c) {
+        return out << c.value;
+    }
+};
+
+#endif //ECE590_COUNTED_H
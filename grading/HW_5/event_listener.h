@@ -0,0 +1,249 @@
+// Test event listener that prints the points and grades of a run.
+
+#ifndef ECE590_EVENT_LISTENER_H
+#define ECE590_EVENT_LISTENER_H
+
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+#include "gtest/gtest.h"
+#include "question_registry.h"
+#include "alloc_counter.h"
+#include "benchmark.h"
+#include "grade_events.h"
+#include "output_capture.h"
+#include "repro.h"
+#include "suite_versions.h"
+
+using namespace testing;
+
+class ConfigurableEventListener : public TestEventListener
+{
+
+protected:
+    TestEventListener* eventListener;
+
+public:
+
+    /**
+     * Show the names of each test case.
+     */
+    bool showTestCases;
+
+    /**
+     * Show the names of each test.
+     */
+    bool showTestNames;
+
+    /**
+     * Show each success.
+     */
+    bool showSuccesses;
+
+    /**
+     * Show each failure as it occurs. You will also see it at the bottom after the full suite is run.
+     */
+    bool showInlineFailures;
+
+    /**
+     * Show the setup of the global environment.
+     */
+    bool showEnvironment;
+
+    /**
+     * Total number of successes
+     */
+    int num_success;
+
+    /**
+     * Total number of failures
+     */
+    int num_failures;
+
+    /**
+     * Total number of tests
+     */
+    int num_tests;
+
+    explicit ConfigurableEventListener(TestEventListener* theEventListener) : eventListener(theEventListener)
+    {
+        showTestCases = true;
+        showTestNames = true;
+        showSuccesses = true;
+        showInlineFailures = true;
+        showEnvironment = true;
+        num_success = 0;
+        num_failures = 0;
+    }
+
+    virtual ~ConfigurableEventListener()
+    {
+        delete eventListener;
+    }
+
+    virtual void OnTestProgramStart(const UnitTest& unit_test)
+    {
+        eventListener->OnTestProgramStart(unit_test);
+        GradeEvents& events = GradeEvents::instance();
+        events.program_start(unit_test.test_to_run_count());
+        for(int id : QuestionRegistry::instance().ids()) {
+            events.question_registered(id, QuestionRegistry::instance().question(id).name);
+        }
+    }
+
+    virtual void OnTestIterationStart(const UnitTest& unit_test, int iteration)
+    {
+        num_success=0;
+        num_failures=0;
+        eventListener->OnTestIterationStart(unit_test, iteration);
+    }
+
+    virtual void OnEnvironmentsSetUpStart(const UnitTest& unit_test)
+    {
+        if(showEnvironment) {
+            eventListener->OnEnvironmentsSetUpStart(unit_test);
+        }
+    }
+
+    virtual void OnEnvironmentsSetUpEnd(const UnitTest& unit_test)
+    {
+        if(showEnvironment) {
+            eventListener->OnEnvironmentsSetUpEnd(unit_test);
+        }
+    }
+
+    virtual void OnTestCaseStart(const TestCase& test_case)
+    {
+        if(showTestCases) {
+            eventListener->OnTestCaseStart(test_case);
+        }
+    }
+
+    virtual void OnTestStart(const TestInfo& test_info)
+    {
+        std::cout << "POINTS: " << num_success << std::endl;
+        if(showTestNames) {
+            eventListener->OnTestStart(test_info);
+        }
+        OutputCapture::instance().begin();
+        Repro::instance().begin(test_info);
+        GradeEvents::instance().test_start(Repro::full_name(test_info));
+    }
+
+    virtual void OnTestPartResult(const TestPartResult& result)
+    {
+        OutputCapture::Bypass bypass;
+        eventListener->OnTestPartResult(result);
+    }
+
+    /**
+     * Why the test left itself out of the grade (SKIPPEDPROPERTY), or NULL.
+     */
+    static const char* skip_reason(const TestInfo& test_info)
+    {
+        const TestResult& result = *test_info.result();
+        for(int i = 0; i < result.test_property_count(); i++) {
+            if(strcmp(result.GetTestProperty(i).key(), SKIPPEDPROPERTY) == 0) {
+                return result.GetTestProperty(i).value();
+            }
+        }
+        return NULL;
+    }
+
+    virtual void OnTestEnd(const TestInfo& test_info)
+    {
+        OutputCapture& capture = OutputCapture::instance();
+        if(capture.enabled()) {
+            CapturedOutput output = capture.end();
+            if(test_info.result()->Failed() && output.size > 0) {
+                printf("[ OUTPUT   ] %zu bytes written, %zu dropped\n%s", output.size, output.dropped(),
+                       output.head.c_str());
+                if(output.dropped() > 0) {
+                    printf("\n[ ...      ] %zu bytes dropped\n", output.dropped());
+                }
+                printf("%s\n", output.tail.c_str());
+            }
+        }
+        if(AllocationCounter::enabled()) {
+            AllocationStats& allocs = AllocationCounter::test_stats();
+            printf("[ ALLOCS   ] %ld allocations, %ld bytes, peak %ld bytes live\n",
+                   allocs.count, allocs.bytes, allocs.peak_live);
+            allocs = AllocationStats();
+        }
+        for(const BenchmarkResult& result : Benchmark::test_results()) {
+            printf("[ BENCH    ] %s\n", result.describe().c_str());
+        }
+        Benchmark::test_results().clear();
+        std::string bundle = Repro::instance().end(test_info);
+        if(!bundle.empty()) {
+            printf("[ REPRO    ] %s\n", bundle.c_str());
+        }
+        if((showInlineFailures && test_info.result()->Failed()) || (showSuccesses && !test_info.result()->Failed())) {
+            eventListener->OnTestEnd(test_info);
+        }
+        GradeEvents::instance().test_end(Repro::full_name(test_info), !test_info.result()->Failed());
+        if(const char* reason = skip_reason(test_info)) {
+            printf("[ SKIPPED  ] %s, not graded\n", reason);
+            return;
+        }
+        num_tests++;
+
+        if((test_info.result()->Failed())) {
+            num_failures++;
+        } else {
+            num_success++;
+        }
+    }
+
+    virtual void OnTestCaseEnd(const TestCase& test_case)
+    {
+        if(showTestCases) {
+            eventListener->OnTestCaseEnd(test_case);
+
+        }
+    }
+
+    virtual void OnEnvironmentsTearDownStart(const UnitTest& unit_test)
+    {
+        if(showEnvironment) {
+            eventListener->OnEnvironmentsTearDownStart(unit_test);
+        }
+    }
+
+    virtual void OnEnvironmentsTearDownEnd(const UnitTest& unit_test)
+    {
+        if(showEnvironment) {
+            eventListener->OnEnvironmentsTearDownEnd(unit_test);
+        }
+    }
+
+    virtual void OnTestIterationEnd(const UnitTest& unit_test, int iteration)
+    {
+        eventListener->OnTestIterationEnd(unit_test, iteration);
+    }
+
+    virtual void OnTestProgramEnd(const UnitTest& unit_test)
+    {
+        eventListener->OnTestProgramEnd(unit_test);
+
+        // per-question tallies, including any merged from other workers
+        QuestionRegistry& registry = QuestionRegistry::instance();
+        printf("\n%s", registry.serialize().c_str());
+        printf("WEIGHTED_GRADE: %g\n", registry.grade() * 100.0);
+        if(SuiteVersions::instance().enabled()) {
+            printf("%s", SuiteVersions::instance().report().c_str());
+        }
+        if(OutputCapture::instance().enabled()) {
+            printf("[ OUTPUT   ] %s\n", OutputCapture::instance().summary().c_str());
+        }
+        GradeEvents::instance().program_end(num_success);
+        if(GradeEvents::instance().dropped() > 0) {
+            printf("[ EVENTS   ] %ld events dropped\n", GradeEvents::instance().dropped());
+        }
+        printf("\nHOMEWORK_GRADE: %d/%d\n", num_success + registry.merged_passed,
+               num_failures + num_success + registry.merged_tests);
+    }
+
+};
+
+#endif //ECE590_EVENT_LISTENER_H
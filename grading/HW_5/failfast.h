@@ -0,0 +1,249 @@
+// Adaptive fail-fast for parameterized tests that keep crashing the same way.
+
+#ifndef ECE590_FAILFAST_H
+#define ECE590_FAILFAST_H
+
+#include <gtest/gtest.h>
+#include <execinfo.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <map>
+#include <string>
+#ifdef __SANITIZE_ADDRESS__
+#include <sanitizer/asan_interface.h>
+#endif
+
+/*
+ * Tracks how the death-test children of each test died. Once the first
+ * "threshold" instances of a parameterized test all crashed with the same
+ * signature (signal or sanitizer error, plus the top stack frame), the
+ * remaining instances of that test are failed in SetUp without running them.
+ *
+ * Flag: --grade_failfast=N (the threshold, 0 by default).
+ */
+class FailFast {
+public:
+
+    static FailFast& instance() {
+        static FailFast failfast;
+        return failfast;
+    }
+
+    /*!
+     * Turn on fail-fast after "n" identical crashes and install the hooks
+     * that let a crashing child report where it died.
+     * @param n
+     */
+    void enable(int n) {
+        threshold = n;
+        if (threshold <= 0 || report != NULL) {
+            return;
+        }
+        report = tmpfile();
+#ifdef __SANITIZE_ADDRESS__
+        __asan_set_error_report_callback(&FailFast::on_asan_report);
+#else
+        // the first backtrace() loads libgcc, which allocates: not in the handler
+        void* frames[1];
+        backtrace(frames, 1);
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = &FailFast::on_signal;
+        action.sa_flags = SA_RESETHAND;
+        int signals[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+        for (int sig : signals) {
+            snprintf(signal_names()[sig], sizeof(signal_names()[sig]), "%s in ", strsignal(sig));
+            sigaction(sig, &action, NULL);
+        }
+#endif
+    }
+
+    bool enabled() const {
+        return threshold > 0;
+    }
+
+    /*!
+     * Called in the parent once a death-test child has exited with "status".
+     * Remembers the first crash signature seen during the current test.
+     * @param status
+     */
+    void record_death(int status) {
+        if (!enabled()) {
+            return;
+        }
+        std::string frame = take_report();
+        if (WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+            return;
+        }
+        if (current_signature.empty()) {
+            if (frame.empty()) {
+                frame = WIFSIGNALED(status) ? strsignal(WTERMSIG(status)) : "exit " + std::to_string(WEXITSTATUS(status));
+            }
+            current_signature = frame;
+        }
+    }
+
+    /*!
+     * Whether the test about to run should be failed without running it.
+     * @param info
+     * @param reason set to a log message when the test is skipped
+     * @return
+     */
+    bool should_skip(const ::testing::TestInfo& info, std::string* reason) {
+        current_signature.clear();
+        if (!enabled()) {
+            return false;
+        }
+        Streak& streak = streaks[key(info)];
+        if (streak.count < threshold || !streak.first) {
+            return false;
+        }
+        *reason = "[ FAILFAST ] skipped: the first " + std::to_string(streak.count) +
+                  " instances crashed with " + streak.signature;
+        return true;
+    }
+
+    /*!
+     * Called at the end of a test that actually ran.
+     * @param info
+     * @param failed
+     */
+    void record_result(const ::testing::TestInfo& info, bool failed) {
+        if (!enabled()) {
+            return;
+        }
+        Streak& streak = streaks[key(info)];
+        if (!streak.first || streak.count >= threshold) {
+            return;
+        }
+        if (!failed || current_signature.empty() ||
+                (streak.count > 0 && streak.signature != current_signature)) {
+            streak.first = false;
+            return;
+        }
+        streak.signature = current_signature;
+        streak.count++;
+    }
+
+private:
+
+    /*
+     * Crash history of the leading instances of one parameterized test.
+     */
+    struct Streak {
+        bool first = true; // still within the leading run of identical crashes
+        int count = 0;
+        std::string signature;
+    };
+
+    int threshold = 0;
+    FILE* report = NULL;
+    std::string current_signature;
+    std::map<std::string, Streak> streaks;
+
+    FailFast() {}
+
+    /*!
+     * "MatrixTests/MatrixTests.Copy/7" -> "MatrixTests/MatrixTests.Copy"
+     */
+    static std::string key(const ::testing::TestInfo& info) {
+        std::string name = info.name();
+        if (info.value_param() != NULL) {
+            name = name.substr(0, name.rfind('/'));
+        }
+        return std::string(info.test_case_name()) + "." + name;
+    }
+
+    /*!
+     * Read and clear whatever the last child wrote to the report file.
+     */
+    std::string take_report() {
+        char buf[512];
+        ssize_t n = pread(fileno(report), buf, sizeof(buf) - 1, 0);
+        if (ftruncate(fileno(report), 0) != 0 || n <= 0) {
+            return "";
+        }
+        buf[n] = '\0';
+        return std::string(buf, strcspn(buf, "\n"));
+    }
+
+    static void write_report(const std::string& signature) {
+        FailFast& self = instance();
+        if (self.report != NULL) {
+            pwrite(fileno(self.report), signature.c_str(), signature.size(), 0);
+        }
+    }
+
+    /*!
+     * Reduce an AddressSanitizer report to "<error> in <top frame>".
+     */
+    static void on_asan_report(const char* text) {
+        std::string report = text;
+        std::string error = "AddressSanitizer";
+        size_t start = report.find("AddressSanitizer: ");
+        if (start != std::string::npos) {
+            start += strlen("AddressSanitizer: ");
+            error = report.substr(start, report.find_first_of(" \n", start) - start);
+        }
+        std::string frame;
+        size_t top = report.find("#0 ");
+        if (top != std::string::npos) {
+            size_t in = report.find(" in ", top);
+            size_t end = report.find('\n', top);
+            if (in != std::string::npos && in < end) {
+                frame = report.substr(in + 4, end - in - 4);
+            }
+        }
+        write_report(error + " in " + frame);
+    }
+
+    /*!
+     * "<signal description> in " for each signal on_signal handles, filled in
+     * by enable(), since strsignal is not async-signal-safe.
+     */
+    static char (&signal_names())[NSIG][64] {
+        static char names[NSIG][64];
+        return names;
+    }
+
+    static void write_text(int fd, const char* text) {
+        size_t left = strlen(text);
+        while (left > 0) {
+            ssize_t n = write(fd, text, left);
+            if (n <= 0) {
+                return;
+            }
+            text += n;
+            left -= n;
+        }
+    }
+
+    /*!
+     * Report the signal and the frame that raised it, then die as before.
+     * Runs in a signal handler, so it only makes async-signal-safe calls
+     * and never allocates: the frame is written straight to the report by
+     * backtrace_symbols_fd, with the newline take_report() drops.
+     */
+    static void on_signal(int sig) {
+        FailFast& self = instance();
+        if (self.report != NULL) {
+            int fd = fileno(self.report);
+            void* frames[3];
+            int n = backtrace(frames, 3);
+            if (lseek(fd, 0, SEEK_SET) == 0) {
+                write_text(fd, signal_names()[sig]);
+                if (n == 3) {
+                    backtrace_symbols_fd(frames + 2, 1, fd);
+                } else {
+                    write_text(fd, "??");
+                }
+            }
+        }
+        raise(sig);
+    }
+};
+
+#endif //ECE590_FAILFAST_H
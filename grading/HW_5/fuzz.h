@@ -0,0 +1,530 @@
+// In-memory, coverage-guided fuzzing of student code, with crashes and hangs confirmed in forks.
+
+#ifndef ECE590_FUZZ_H
+#define ECE590_FUZZ_H
+
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <typeinfo>
+#include <vector>
+#include <gtest/gtest.h>
+#include "case_generator.h"
+#ifdef __SANITIZE_ADDRESS__
+#include <sanitizer/common_interface_defs.h>
+#endif
+
+#define FUZZMAPSIZE (1 << 14) // edges in the coverage map
+#define FUZZBINARY "bin/fuzz" // the tests with COVERED instrumented, from the homework directory
+#define FUZZSESSION "GRADE_FUZZ_SESSION" // tells FUZZBINARY the fd of the session it fuzzes for
+
+/*
+ * Edge coverage of the student sources compiled with
+ * -fsanitize-coverage=trace-pc (COVERED in MakefileGrade), counted by the
+ * hook in fuzz.cc. Only counted while "map" is set, and only in FUZZBINARY:
+ * bin/test runs the student code uninstrumented.
+ */
+struct FuzzCoverage {
+    static unsigned char* map;  // hit count of each edge, or NULL
+    static uintptr_t previous;  // the last block reached, shifted
+};
+
+/*
+ * A crash or hang, with the smallest input found that still causes it.
+ */
+struct FuzzFinding {
+    enum Kind {
+        NONE,
+        CRASH,  // killed by a signal, a sanitizer or exit()
+        HANG    // still running after the time limit
+    };
+
+    Kind kind = NONE;
+    std::string input;
+    std::string how;    // signal, sanitizer error or time limit
+
+    std::string describe() const {
+        if (kind == NONE) {
+            return "no crash or hang";
+        }
+        std::ostringstream out;
+        out << (kind == CRASH ? "crash" : "hang") << " (" << how << ") on this " << input.size()
+            << " byte input: \"" << escape(input) << "\"";
+        return out.str();
+    }
+
+    /*!
+     * C-style escapes for newlines, tabs, quotes and other unprintable bytes.
+     */
+    static std::string escape(const std::string& text) {
+        std::string escaped;
+        for (unsigned char c : text) {
+            char hex[8];
+            switch (c) {
+                case '\n': escaped += "\\n"; break;
+                case '\r': escaped += "\\r"; break;
+                case '\t': escaped += "\\t"; break;
+                case '"': escaped += "\\\""; break;
+                case '\\': escaped += "\\\\"; break;
+                default:
+                    if (c < 32 || c > 126) {
+                        snprintf(hex, sizeof(hex), "\\x%02x", c);
+                        escaped += hex;
+                    } else {
+                        escaped += c;
+                    }
+            }
+        }
+        return escaped;
+    }
+};
+
+/*
+ * Mutates inputs to a target, a void(const std::string& path) function,
+ * and runs it on each without forking. The input is written to a memfd,
+ * which the target opens as "/proc/self/fd/<n>", so there is no file on
+ * disk. An input that reaches new coverage edges, or ends the target in a
+ * new way (returning, or throwing a new exception type), is kept in the
+ * corpus that later inputs are mutated from.
+ *
+ * The inputs run in one forked child for the whole session, so a crash or
+ * sanitizer error only kills that child. The child execs FUZZBINARY, which
+ * runs the same test up to the same run() and fuzzes there, with coverage.
+ * Without FUZZBINARY, e.g. if only bin/test was built, it fuzzes in the fork,
+ * guided only by the ways the target ends. The input running at the time is
+ * kept in memory shared with the parent, which also kills the child when an
+ * input runs for longer than "hang_ms". Only then is the input run again in
+ * a fresh fork, to confirm it, and cut down to the smallest input that
+ * still crashes or hangs the same way. An input that does not do it again is
+ * dropped, and fuzzing resumes in a new child.
+ *
+ * The session ends after "max_executions" inputs, so a given seed runs the
+ * same inputs however loaded the machine is. A wall-clock limit, "budget_ms",
+ * is off unless set; a session it stops, or that ran out of restarts, is
+ * cut_short() and says so in its summary().
+ */
+class Fuzzer {
+public:
+    typedef std::function<void(std::string&, CaseGenerator::Random&)> Mutation;
+
+    long max_executions = 20000;
+    double budget_ms = 0;           // wall-clock limit of the session, 0 for none
+    double hang_ms = 250;
+    size_t max_length = 4096;
+    int max_minimize = 300;         // runs spent cutting down a finding
+    double minimize_ms = 3000;
+    unsigned seed = 520;
+    std::vector<std::string> seeds; // valid inputs the corpus starts from
+    std::vector<Mutation> mutations; // besides the generic byte-level ones
+
+    /*!
+     * Fuzz "target" and return the first confirmed crash or hang.
+     */
+    template <typename Target>
+    FuzzFinding run(Target target) {
+        if (const char* session = getenv(FUZZSESSION)) {
+            // FUZZBINARY, exec'd by the child of the session below
+            shared = (Shared*) mmap(NULL, sizeof(Shared) + max_length, PROT_READ | PROT_WRITE,
+                                    MAP_SHARED, atoi(session), 0);
+            if (shared == MAP_FAILED) {
+                _exit(125);
+            }
+            restarts = shared->restarts;
+            fuzz(target, shared->session_ns);
+        }
+        int memory = memfd_create("fuzz-session", 0);
+        if (memory < 0 || ftruncate(memory, sizeof(Shared) + max_length) < 0) {
+            ADD_FAILURE() << "no memory to share with the fuzzing child: " << strerror(errno);
+            return FuzzFinding();
+        }
+        shared = (Shared*) mmap(NULL, sizeof(Shared) + max_length, PROT_READ | PROT_WRITE,
+                                MAP_SHARED, memory, 0);
+        uint64_t started = now_ns();
+        shared->session_ns = started;
+        FuzzFinding finding;
+        for (restarts = 0; restarts < 10; restarts++) {
+            shared->restarts = restarts;
+            std::cout.flush();
+            fflush(stdout);
+            fflush(stderr);
+            pid_t child = fork();
+            if (child == 0) {
+                exec_covered(memory);
+                fuzz(target, started);
+            }
+            int status;
+            bool hung = false;
+            while (waitpid(child, &status, WNOHANG) == 0) {
+                uint64_t running = __atomic_load_n(&shared->started_ns, __ATOMIC_SEQ_CST);
+                if (running != 0 && now_ns() - running > hang_ms * 1e6) {
+                    kill(child, SIGKILL);
+                    waitpid(child, &status, 0);
+                    hung = true;
+                    break;
+                }
+                struct timespec pause = {0, 5000000};
+                nanosleep(&pause, NULL);
+            }
+            if (!hung && shared->done) {
+                break;
+            }
+            std::string input(shared->input, shared->length);
+            FuzzFinding::Kind suspected = hung ? FuzzFinding::HANG : FuzzFinding::CRASH;
+            std::string how;
+            if (confirm(target, input, &how) == suspected) {
+                finding.kind = suspected;
+                finding.how = how;
+                finding.input = minimize(target, input, suspected, how);
+                break;
+            }
+            shared->executions++; // skip the input that did not do it again
+        }
+        executions = shared->executions;
+        corpus_size = shared->corpus_size;
+        edges = shared->edges;
+        seconds = (now_ns() - started) / 1e9;
+        stopped_early = finding.kind == FuzzFinding::NONE && executions < max_executions;
+        munmap(shared, sizeof(Shared) + max_length);
+        close(memory);
+        return finding;
+    }
+
+    /*!
+     * e.g. "20000 executions in 0.41 s (48780/s), 23 inputs in the corpus, 117 edges"
+     */
+    std::string summary() const {
+        std::ostringstream out;
+        out << executions << " executions in " << seconds << " s (" << (long) (executions / std::max(seconds, 1e-9))
+            << "/s), " << corpus_size << " inputs in the corpus, " << edges << " edges";
+        if (restarts > 0) {
+            out << ", " << restarts << " restarts";
+        }
+        if (stopped_early) {
+            out << ", cut short after " << executions << " of " << max_executions << " executions";
+        }
+        return out.str();
+    }
+
+    /*!
+     * Whether the last session ended without a finding before running every
+     * input, stopped by "budget_ms" or by crashes that did not happen again.
+     */
+    bool cut_short() const {
+        return stopped_early;
+    }
+
+private:
+
+    /*
+     * What the fuzzing child shares with the parent.
+     */
+    struct Shared {
+        uint64_t session_ns;   // when run() started
+        int restarts;
+        uint64_t started_ns;   // when the running input started, or 0
+        long executions;
+        long corpus_size;
+        long edges;
+        int done;              // every execution ran
+        size_t length;
+        char input[];          // the running input, max_length bytes
+    };
+
+    Shared* shared = NULL;
+    int restarts = 0;
+    long executions = 0;
+    long corpus_size = 0;
+    long edges = 0;
+    double seconds = 0;
+    bool stopped_early = false;
+
+    static uint64_t now_ns() {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return now.tv_sec * 1000000000ull + now.tv_nsec;
+    }
+
+    /*!
+     * A memfd holding "input" and the path the target opens it by.
+     */
+    static std::string memory_file(const std::string& input, int* fd) {
+        if (*fd < 0) {
+            *fd = memfd_create("fuzz", MFD_CLOEXEC);
+        }
+        if (ftruncate(*fd, 0) < 0 || pwrite(*fd, input.data(), input.size(), 0) < 0) {
+            _exit(125);
+        }
+        return "/proc/self/fd/" + std::to_string(*fd);
+    }
+
+    /*!
+     * Send stdout to /dev/null, and stderr and sanitizer reports to "err",
+     * or /dev/null too if it is -1. The reports may have been pointed at the
+     * real stderr (OutputCapture), where "err" would not see them.
+     */
+    static void quiet(int err) {
+        int null = open("/dev/null", O_WRONLY);
+        dup2(null, STDOUT_FILENO);
+        dup2(err < 0 ? null : err, STDERR_FILENO);
+        close(null);
+#ifdef __SANITIZE_ADDRESS__
+        __sanitizer_set_report_fd((void*) (intptr_t) STDERR_FILENO);
+#endif
+    }
+
+    /*!
+     * Replace the fuzzing child with FUZZBINARY running the current test, on
+     * the same seed and budget, with the shared memory in "memory". Returns
+     * if it cannot, to fuzz without coverage.
+     */
+    static void exec_covered(int memory) {
+        const ::testing::TestInfo* test = ::testing::UnitTest::GetInstance()->current_test_info();
+        if (test == NULL || access(FUZZBINARY, X_OK) != 0) {
+            return;
+        }
+        std::ostringstream budget;
+        budget << std::setprecision(17) << "--grade_budget=" << CaseGenerator::budget_scale();
+        std::string filter = std::string("--gtest_filter=") + test->test_case_name() + "." + test->name(),
+                    seed = "--grade_seed=" + std::to_string(CaseGenerator::seed()),
+                    scale = budget.str();
+        char* argv[] = {(char*) FUZZBINARY, &filter[0], &seed[0], &scale[0], NULL};
+        setenv(FUZZSESSION, std::to_string(memory).c_str(), 1);
+        quiet(-1);
+        execv(FUZZBINARY, argv);
+        unsetenv(FUZZSESSION);
+    }
+
+    /*!
+     * The fuzzing child: runs the seeds, then mutants of the corpus.
+     * Never returns.
+     */
+    template <typename Target>
+    void fuzz(Target& target, uint64_t started) {
+        quiet(-1);
+        std::vector<unsigned char> map(FUZZMAPSIZE), seen(FUZZMAPSIZE);
+        FuzzCoverage::map = map.data();
+        CaseGenerator::Random random(seed + restarts);
+        // after a restart, the seeds already run are back in the corpus
+        std::vector<std::string> corpus(seeds.begin(), seeds.begin() + std::min(shared->executions, (long) seeds.size()));
+        shared->edges = 0;
+        int fd = -1;
+        for (long n = shared->executions; n < max_executions; n++) {
+            if (budget_ms > 0 && (now_ns() - started) / 1e6 > budget_ms) {
+                break;
+            }
+            std::string input;
+            if (n < (long) seeds.size()) {
+                input = seeds[n];
+            } else if (!corpus.empty()) {
+                input = mutate(corpus[random.uniform(0, corpus.size() - 1)], corpus, random);
+            }
+            input.resize(std::min(input.size(), max_length));
+            memcpy(shared->input, input.data(), input.size());
+            shared->length = input.size();
+            std::string path = memory_file(input, &fd);
+
+            memset(map.data(), 0, map.size());
+            FuzzCoverage::previous = 0;
+            __atomic_store_n(&shared->started_ns, now_ns(), __ATOMIC_SEQ_CST);
+            std::string outcome = "returned";
+            try {
+                target(path);
+            } catch (const std::exception& e) {
+                outcome = typeid(e).name();
+            } catch (...) {
+                outcome = "...";
+            }
+            __atomic_store_n(&shared->started_ns, 0, __ATOMIC_SEQ_CST);
+            map[std::hash<std::string>()(outcome) % FUZZMAPSIZE]++;
+
+            if (new_coverage(map.data(), seen.data()) || n < (long) seeds.size()) {
+                corpus.push_back(input);
+            }
+            shared->executions = n + 1;
+            shared->corpus_size = corpus.size();
+        }
+        FuzzCoverage::map = NULL;
+        shared->done = 1;
+        _exit(0);
+    }
+
+    /*!
+     * Whether "map" hit an edge, or an edge a number of times, not seen
+     * before. Hit counts are bucketed as in AFL: 1, 2, 3, 4-7, ..., 128+.
+     * Runs after every input, so it skips untouched words of the map and
+     * is not instrumented by the sanitizer.
+     */
+    __attribute__((no_sanitize_address))
+    bool new_coverage(const unsigned char* map, unsigned char* seen) {
+        bool fresh = false;
+        const uint64_t* words = (const uint64_t*) map;
+        for (size_t w = 0; w < FUZZMAPSIZE / 8; w++) {
+            if (words[w] == 0) {
+                continue;
+            }
+            for (size_t i = w * 8; i < w * 8 + 8; i++) {
+                unsigned char bucket = map[i] ? hits_bucket(map[i]) : 0;
+                if (bucket & ~seen[i]) {
+                    shared->edges += seen[i] == 0;
+                    seen[i] |= bucket;
+                    fresh = true;
+                }
+            }
+        }
+        return fresh;
+    }
+
+    static unsigned char hits_bucket(unsigned char hits) {
+        if (hits <= 3) {
+            return 1 << (hits - 1);
+        }
+        return hits >= 128 ? 128 : hits >= 32 ? 64 : hits >= 16 ? 32 : hits >= 8 ? 16 : 8;
+    }
+
+    /*!
+     * One to four mutations, each the caller's or a generic one.
+     */
+    std::string mutate(std::string input, const std::vector<std::string>& corpus, CaseGenerator::Random& random) {
+        int count = random.uniform(1, 4);
+        for (int i = 0; i < count; i++) {
+            if (!mutations.empty() && random.chance(0.6)) {
+                mutations[random.uniform(0, mutations.size() - 1)](input, random);
+                continue;
+            }
+            size_t at = input.empty() ? 0 : random.uniform(0, input.size() - 1);
+            switch (random.uniform(0, 4)) {
+                case 0: // flip a bit
+                    if (!input.empty()) {
+                        input[at] ^= 1 << random.uniform(0, 7);
+                    }
+                    break;
+                case 1: // delete a few bytes
+                    input.erase(at, random.uniform(1, 8));
+                    break;
+                case 2: // insert a random byte
+                    input.insert(input.begin() + at, (char) random.uniform(0, 255));
+                    break;
+                case 3: // repeat a chunk
+                    input.insert(at, input.substr(at, random.uniform(1, 32)));
+                    break;
+                default: { // splice in part of another input
+                    const std::string& other = corpus[random.uniform(0, corpus.size() - 1)];
+                    if (!other.empty()) {
+                        input = input.substr(0, at) + other.substr(random.uniform(0, other.size() - 1));
+                    }
+                }
+            }
+        }
+        return input;
+    }
+
+    /*!
+     * Run "input" in a fresh fork and report what happened to it.
+     */
+    template <typename Target>
+    FuzzFinding::Kind confirm(Target& target, const std::string& input, std::string* how) {
+        int err = memfd_create("fuzz-stderr", MFD_CLOEXEC);
+        std::cout.flush();
+        fflush(stdout);
+        fflush(stderr);
+        pid_t child = fork();
+        if (child == 0) {
+            quiet(err);
+            int signals[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+            for (int sig : signals) {
+                signal(sig, SIG_DFL);
+            }
+            int fd = -1;
+            std::string path = memory_file(input, &fd);
+            try {
+                target(path);
+            } catch (...) {
+            }
+            _exit(0);
+        }
+
+        uint64_t started = now_ns();
+        double limit_ms = 4 * hang_ms;
+        int status;
+        while (waitpid(child, &status, WNOHANG) == 0) {
+            if ((now_ns() - started) / 1e6 > limit_ms) {
+                kill(child, SIGKILL);
+                waitpid(child, &status, 0);
+                close(err);
+                *how = "still running after " + std::to_string((int) limit_ms) + " ms";
+                return FuzzFinding::HANG;
+            }
+            struct timespec pause = {0, 1000000};
+            nanosleep(&pause, NULL);
+        }
+        std::string report = sanitizer_error(err);
+        close(err);
+        if (!report.empty()) {
+            *how = report;
+        } else if (WIFSIGNALED(status)) {
+            *how = strsignal(WTERMSIG(status));
+        } else if (WEXITSTATUS(status) != 0) {
+            *how = "exit " + std::to_string(WEXITSTATUS(status));
+        } else {
+            return FuzzFinding::NONE;
+        }
+        return FuzzFinding::CRASH;
+    }
+
+    /*!
+     * The kind of error in a sanitizer report on "err", e.g.
+     * "AddressSanitizer: heap-buffer-overflow", or "".
+     */
+    static std::string sanitizer_error(int err) {
+        char text[4096];
+        ssize_t n = pread(err, text, sizeof(text) - 1, 0);
+        text[std::max(n, (ssize_t) 0)] = '\0';
+        const char* error = strstr(text, "ERROR: ");
+        if (error == NULL) {
+            return "";
+        }
+        std::string line(error + 7, strcspn(error + 7, "\n"));
+        return line.substr(0, line.find(" on "));
+    }
+
+    /*!
+     * Cut chunks out of "input", halving their size down to one byte, as long
+     * as it still crashes or hangs the same way.
+     */
+    template <typename Target>
+    std::string minimize(Target& target, std::string input, FuzzFinding::Kind kind, const std::string& how) {
+        uint64_t started = now_ns();
+        int tries = 0;
+        for (size_t chunk = std::max(input.size() / 2, (size_t) 1); chunk >= 1; chunk /= 2) {
+            for (size_t at = 0; at + chunk <= input.size(); ) {
+                if (tries++ >= max_minimize || (now_ns() - started) / 1e6 > minimize_ms) {
+                    return input;
+                }
+                std::string candidate = input.substr(0, at) + input.substr(at + chunk);
+                std::string candidate_how;
+                FuzzFinding::Kind result = confirm(target, candidate, &candidate_how);
+                if (result == kind && (kind == FuzzFinding::HANG || candidate_how == how)) {
+                    input = candidate;
+                } else {
+                    at += chunk;
+                }
+            }
+        }
+        return input;
+    }
+};
+
+#endif //ECE590_FUZZ_H
@@ -6,6 +6,7 @@
 
 #include <gtest/gtest.h>
 #include <stdlib.h>
+#include "failfast.h"
 
 #define GTEST_COUT std::cerr             << "[    INFO  ] "
 #define GTEST_COUT_ERROR std::cerr       << "[ SEGFAULT ] "
@@ -29,11 +30,14 @@
       ::testing::internal::scoped_ptr< ::testing::internal::DeathTest> \
           gtest_dt_ptr(gtest_dt); \
       switch (gtest_dt->AssumeRole()) { \
-        case ::testing::internal::DeathTest::OVERSEE_TEST: \
-          if (gtest_dt->Passed(predicate(gtest_dt->Wait()))) { \
+        case ::testing::internal::DeathTest::OVERSEE_TEST: { \
+          const int gtest_status = gtest_dt->Wait(); \
+          FailFast::instance().record_death(gtest_status); \
+          if (gtest_dt->Passed(predicate(gtest_status))) { \
             goto GTEST_CONCAT_TOKEN_(gtest_label_, __LINE__); \
           } \
           break; \
+        } \
         case ::testing::internal::DeathTest::EXECUTE_TEST: { \
           ::testing::internal::DeathTest::ReturnSentinel \
               gtest_sentinel(gtest_dt); \
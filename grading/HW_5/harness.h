@@ -0,0 +1,147 @@
+// Runs the graded test suite: the body of bin/test.
+
+#ifndef ECE590_HARNESS_H
+#define ECE590_HARNESS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sstream>
+#include "gtest/gtest.h"
+#include "failfast.h"
+#include "case_generator.h"
+#include "question_registry.h"
+#include "output_capture.h"
+#include "repro.h"
+#include "suite_versions.h"
+#include "grade_events.h"
+#include "event_listener.h"
+
+/**
+ * Value of a grading argument "--grade_<name>=<value>", or NULL if absent.
+ * Google Test ignores these, so they can be mixed with --gtest_* flags.
+ */
+inline const char* grade_flag(int argc, char **argv, const char* name)
+{
+    std::string prefix = std::string("--grade_") + name + "=";
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], prefix.c_str(), prefix.size()) == 0) {
+            return argv[i] + prefix.size();
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Narrow --gtest_filter to the tests that "filter" selects as well, by
+ * replacing it with the list of those tests.
+ */
+inline void narrow_gtest_filter(const char* filter)
+{
+    std::string tests;
+    const ::testing::UnitTest& unit_test = *::testing::UnitTest::GetInstance();
+    for (int i = 0; i < unit_test.total_test_case_count(); i++) {
+        const ::testing::TestCase& test_case = *unit_test.GetTestCase(i);
+        for (int j = 0; j < test_case.total_test_count(); j++) {
+            std::string name = std::string(test_case.name()) + "." + test_case.GetTestInfo(j)->name();
+            if (SuiteVersions::matches_filter(name, ::testing::GTEST_FLAG(filter)) &&
+                    SuiteVersions::matches_filter(name, filter)) {
+                tests += (tests.empty() ? "" : ":") + name;
+            }
+        }
+    }
+    ::testing::GTEST_FLAG(filter) = tests.empty() ? "-*" : tests;
+}
+
+/**
+ * Parse the grading arguments, run every registered test with the
+ * ConfigurableEventListener and print the grades.
+ *
+ * FailFast, OutputCapture, Repro, SuiteVersions and GradeEvents are each
+ * disabled unless enabled here by their --grade_<name> flag, which their
+ * headers name.
+ */
+inline int run_graded_tests(int argc, char **argv)
+{
+    // generated test cases and random data both follow the seed
+    if (const char* seed = grade_flag(argc, argv, "seed")) {
+        CaseGenerator::seed() = strtoul(seed, NULL, 10);
+    }
+    if (const char* budget = grade_flag(argc, argv, "budget")) {
+        CaseGenerator::budget_scale() = atof(budget);
+    }
+    srand(CaseGenerator::seed());
+
+    // initialize
+//    ::testing::GTEST_FLAG(filter) = "*Matrix*";
+    ::testing::InitGoogleTest(&argc, argv);
+    CaseGenerator::report();
+
+    // only the tests --grade_filter selects too, e.g. the timing tests
+    if (const char* filter = grade_flag(argc, argv, "filter")) {
+        narrow_gtest_filter(filter);
+    }
+
+    // versions of the suite graded alongside the full suite
+    if (const char* versions = grade_flag(argc, argv, "versions")) {
+        SuiteVersions::instance().load(versions);
+    }
+
+    // tallies of other workers, e.g. the other shards of this suite
+    if (const char* merge = grade_flag(argc, argv, "merge")) {
+        std::stringstream paths(merge);
+        std::string path;
+        while (std::getline(paths, path, ',')) {
+            QuestionRegistry::instance().merge(path);
+            SuiteVersions::instance().merge(path);
+        }
+    }
+
+    // fail the rest of a parameterized test once its first instances crash identically
+    if (const char* failfast = grade_flag(argc, argv, "failfast")) {
+        FailFast::instance().enable(atoi(failfast));
+    }
+
+    // keep only the first and last bytes of what each test prints
+    if (const char* capture = grade_flag(argc, argv, "capture")) {
+        size_t head = 0, tail = 0;
+        if (sscanf(capture, "%zu,%zu", &head, &tail) == 1) {
+            tail = head;
+        }
+        OutputCapture::instance().enable(head, tail);
+    }
+
+    // leave a bundle for rerunning each failed test on its own
+    if (const char* repro = grade_flag(argc, argv, "repro")) {
+        Repro::instance().enable(repro, argc, argv);
+    }
+
+    // publish each test to a live aggregator, e.g. tools/bin/gradewatch
+    if (const char* events = grade_flag(argc, argv, "events")) {
+        std::string socket = events, label;
+        size_t comma = socket.find(',');
+        if (comma != std::string::npos) {
+            label = socket.substr(comma + 1);
+            socket = socket.substr(0, comma);
+        }
+        GradeEvents::instance().enable(socket, label);
+    }
+
+    // remove the default listener
+    testing::TestEventListeners& listeners = testing::UnitTest::GetInstance()->listeners();
+    auto default_printer = listeners.Release(listeners.default_result_printer());
+
+    // configure custom printer
+    ConfigurableEventListener *listener = new ConfigurableEventListener(default_printer);
+    listener->showEnvironment = false;
+    listener->showTestCases = false;
+    listener->showTestNames = true;
+    listener->showSuccesses = true;
+    listener->showInlineFailures = true;
+    listeners.Append(listener);
+
+    // run
+    return RUN_ALL_TESTS();
+}
+
+#endif //ECE590_HARNESS_H
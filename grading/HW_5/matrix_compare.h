@@ -0,0 +1,188 @@
+// Whole-matrix value checks, reported as one assertion.
+
+#ifndef ECE590_MATRIX_COMPARE_H
+#define ECE590_MATRIX_COMPARE_H
+
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <gtest/gtest.h>
+#include "typed_matrix.h"
+
+#define MATRIXDIFFERENCES 5 // differing cells listed in a failure
+
+/*
+ * How far a value may be from the expected one.
+ */
+struct MatrixTolerance {
+    enum Kind {
+        ABSOLUTE,   // |actual - expected| <= amount
+        RELATIVE,   // |actual - expected| <= amount * |expected|
+        ULP         // at most "amount" doubles apart, as ASSERT_DOUBLE_EQ (4)
+    };
+
+    Kind kind;
+    double amount;
+
+    static MatrixTolerance absolute(double amount) {
+        return {ABSOLUTE, amount};
+    }
+
+    static MatrixTolerance relative(double amount) {
+        return {RELATIVE, amount};
+    }
+
+    static MatrixTolerance ulps(int amount) {
+        return {ULP, (double) amount};
+    }
+
+    std::string describe() const {
+        std::ostringstream out;
+        out << "within " << amount << (kind == RELATIVE ? " relative" : kind == ULP ? " ULP" : "");
+        return out.str();
+    }
+};
+
+/*
+ * The result of comparing a matrix with the expected values.
+ */
+struct MatrixComparison {
+    struct Difference {
+        int row;
+        int col;
+        double actual;
+        double expected;
+    };
+
+    int rows = 0;               // expected shape
+    int cols = 0;
+    int actual_rows = 0;
+    int actual_cols = 0;
+    MatrixTolerance tolerance = MatrixTolerance::absolute(0);
+    long mismatches = 0;
+    double max_error = 0;       // in the unit of the tolerance; infinite for a NaN
+    std::vector<Difference> first; // the first MATRIXDIFFERENCES, row by row
+
+    bool ok() const {
+        return rows == actual_rows && cols == actual_cols && mismatches == 0;
+    }
+
+    /*!
+     * e.g. "3 of 10000 values differ (max error 0.5, expected within
+     * 0.0001): (0, 7) is 1.5, expected 1; ..."
+     */
+    std::string describe() const {
+        std::ostringstream out;
+        if (rows != actual_rows || cols != actual_cols) {
+            out << "the matrix is " << actual_rows << "x" << actual_cols << ", expected " << rows << "x" << cols;
+            return out.str();
+        }
+        out << mismatches << " of " << (long) rows * cols << " values differ (max error " << max_error
+            << ", expected " << tolerance.describe() << ")";
+        out << std::setprecision(17); // so values a few ULP apart print differently
+        for (size_t k = 0; k < first.size(); k++) {
+            out << (k == 0 ? ": " : "; ") << "(" << first[k].row << ", " << first[k].col << ") is "
+                << first[k].actual << ", expected " << first[k].expected;
+        }
+        if (mismatches > (long) first.size()) {
+            out << "; ...";
+        }
+        return out.str();
+    }
+};
+
+/*
+ * Compares a whole matrix at once: the student's values are read into one
+ * buffer, which is compared with the expected values two at a time with GCC
+ * vector extensions (SSE2 on x86-64, NEON on ARM), so a 1000x1000 check is
+ * one pass over memory instead of a million assertions. Values that are
+ * equal, including infinities, or both NaN, always match.
+ */
+class MatrixCompare {
+public:
+
+    /*!
+     * The values of "m", row by row, read with one get() each.
+     */
+    template <typename T>
+    static std::vector<double> values(const TypedMatrix<T>& m) {
+        int rows = m.num_rows(),
+            cols = m.num_cols();
+        std::vector<double> flat((size_t) rows * cols);
+        for (int i = 0; i < rows; i++) {
+            for (int j = 0; j < cols; j++) {
+                flat[(size_t) i * cols + j] = m.get(i, j);
+            }
+        }
+        return flat;
+    }
+
+    template <typename T>
+    static std::vector<double> values(const std::vector<std::vector<T>>& v) {
+        std::vector<double> flat;
+        for (const std::vector<T>& row : v) {
+            flat.insert(flat.end(), row.begin(), row.end());
+        }
+        return flat;
+    }
+
+    /*!
+     * Compare "actual" with "expected", both "rows" x "cols" row by row.
+     * Defined in matrix_compare.cc, which MakefileGrade optimizes.
+     */
+    static MatrixComparison compare(const std::vector<double>& actual, const std::vector<double>& expected,
+                                    int rows, int cols, MatrixTolerance tolerance);
+
+    /*!
+     * Compare the student's "actual" with the values it should hold.
+     */
+    template <typename T, typename E>
+    static MatrixComparison compare(const TypedMatrix<T>& actual, const std::vector<std::vector<E>>& expected,
+                                    MatrixTolerance tolerance) {
+        int rows = expected.size(),
+            cols = rows > 0 ? expected[0].size() : 0;
+        if (actual.num_rows() != rows || (rows > 0 && actual.num_cols() != cols)) { // any width of no rows
+            MatrixComparison result;
+            result.rows = rows;
+            result.cols = cols;
+            result.actual_rows = actual.num_rows();
+            result.actual_cols = actual.num_cols();
+            return result;
+        }
+        return compare(values(actual), values(expected), rows, cols, tolerance);
+    }
+
+    template <typename T>
+    static MatrixComparison compare(const TypedMatrix<T>& actual, const TypedMatrix<T>& expected,
+                                    MatrixTolerance tolerance) {
+        if (actual.num_rows() != expected.num_rows() || actual.num_cols() != expected.num_cols()) {
+            MatrixComparison result;
+            result.rows = expected.num_rows();
+            result.cols = expected.num_cols();
+            result.actual_rows = actual.num_rows();
+            result.actual_cols = actual.num_cols();
+            return result;
+        }
+        return compare(values(actual), values(expected), expected.num_rows(), expected.num_cols(), tolerance);
+    }
+};
+
+/*
+ * Fails once, with the number of cells that differ, the largest error and
+ * the first few cells, unless every value of "actual" (a TypedMatrix) is
+ * within "tolerance" of "expected" (a TypedMatrix or vector<vector>).
+ */
+#define EXPECT_MATRIX_NEAR(actual, expected, tolerance) \
+    do { \
+        MatrixComparison gtest_matrix = MatrixCompare::compare((actual), (expected), (tolerance)); \
+        EXPECT_TRUE(gtest_matrix.ok()) << gtest_matrix.describe(); \
+    } while (0)
+
+#define ASSERT_MATRIX_NEAR(actual, expected, tolerance) \
+    do { \
+        MatrixComparison gtest_matrix = MatrixCompare::compare((actual), (expected), (tolerance)); \
+        ASSERT_TRUE(gtest_matrix.ok()) << gtest_matrix.describe(); \
+    } while (0)
+
+#endif //ECE590_MATRIX_COMPARE_H
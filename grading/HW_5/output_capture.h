@@ -0,0 +1,349 @@
+// Bounded capture of what each test writes to stdout and stderr.
+
+#ifndef ECE590_OUTPUT_CAPTURE_H
+#define ECE590_OUTPUT_CAPTURE_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <signal.h>
+#include <algorithm>
+#include <iostream>
+#include <string>
+#ifdef __SANITIZE_ADDRESS__
+#include <sanitizer/common_interface_defs.h>
+#endif
+
+#define CAPTUREPIPEBYTES (1 << 20) // pipe buffer asked for, so a test rarely waits on the reader
+
+/*
+ * What one test wrote: its first and last bytes and how many were dropped
+ * in between.
+ */
+struct CapturedOutput {
+    std::string head;
+    std::string tail;
+    size_t size = 0; // bytes written in total
+
+    size_t dropped() const {
+        return size - head.size() - tail.size();
+    }
+};
+
+/*
+ * Redirects stdout and stderr, including the output of student code and
+ * of death-test children, into a pipe for the length of each test. A reader
+ * process keeps the first "head" bytes, the last "tail" bytes in a circular
+ * buffer, and the number of bytes written, in memory shared with the test
+ * program. When the test ends, the reader drains the pipe, and the head and
+ * tail are read back. The listener in event_listener.h prints them only when
+ * the test fails.
+ *
+ * The pipe is drained by a forked process rather than a thread: the death
+ * tests fork, and forking a process with a second thread can leave the child
+ * waiting on a lock that thread held. The memory used does not depend on how
+ * much a test prints, and a test that prints in a loop only waits on the
+ * reader.
+ *
+ * Flag: --grade_capture=<head>,<tail>.
+ */
+class OutputCapture {
+public:
+
+    static OutputCapture& instance() {
+        static OutputCapture capture;
+        return capture;
+    }
+
+    /*!
+     * Keep the first "head" and last "tail" bytes of each test's output.
+     * Sanitizer reports keep going to the real stderr, so a crash that
+     * kills the whole program is still explained in the log.
+     */
+    void enable(size_t head, size_t tail) {
+        int pipes[2], control[2];
+        if (pipe2(pipes, O_CLOEXEC) < 0) {
+            return;
+        }
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, control) < 0) {
+            close(pipes[0]);
+            close(pipes[1]);
+            return;
+        }
+        fcntl(pipes[1], F_SETPIPE_SZ, CAPTUREPIPEBYTES);
+        ring_bytes = sizeof(Ring) + head + tail;
+        ring = (Ring*) mmap(NULL, ring_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (ring == MAP_FAILED) {
+            ring = NULL;
+            close(pipes[0]);
+            close(pipes[1]);
+            close(control[0]);
+            close(control[1]);
+            return;
+        }
+        ring->head_bytes = head;
+        ring->tail_bytes = tail;
+        flush();
+        pid_t child = fork();
+        if (child == 0) {
+            close(pipes[1]);
+            close(control[0]);
+            read_output(pipes[0], control[1], ring);
+        }
+        close(pipes[0]);
+        close(control[1]);
+        if (child < 0) {
+            close(pipes[1]);
+            close(control[0]);
+            munmap(ring, ring_bytes);
+            ring = NULL;
+            return;
+        }
+        reader = child;
+        sink = pipes[1];
+        requests = control[0];
+        real_out = dup(STDOUT_FILENO);
+        real_err = dup(STDERR_FILENO);
+        fcntl(real_out, F_SETFD, FD_CLOEXEC);
+        fcntl(real_err, F_SETFD, FD_CLOEXEC);
+#ifdef __SANITIZE_ADDRESS__
+        __sanitizer_set_report_fd((void*) (intptr_t) real_err);
+#endif
+    }
+
+    bool enabled() const {
+        return sink >= 0;
+    }
+
+    bool capturing() const {
+        return active;
+    }
+
+    /*!
+     * Start capturing the output of a test.
+     */
+    void begin() {
+        if (!enabled() || active) {
+            return;
+        }
+        flush();
+        // whatever is left from before this test is dropped
+        if (request(RESET)) {
+            redirect(sink, sink);
+            active = true;
+        }
+    }
+
+    /*!
+     * Stop capturing and restore stdout and stderr.
+     * @return the captured output of the test
+     */
+    CapturedOutput end() {
+        CapturedOutput output;
+        if (!active) {
+            return output;
+        }
+        flush();
+        redirect(real_out, real_err);
+        active = false;
+        clearerr(stdout);
+        clearerr(stderr);
+        std::cout.clear();
+        std::cerr.clear();
+        if (!request(DRAIN)) {
+            return output;
+        }
+
+        output.size = ring->total;
+        size_t head_size = std::min(output.size, ring->head_bytes);
+        output.head.assign(ring->data, head_size);
+        size_t tail_size = std::min(output.size - head_size, ring->tail_bytes);
+        if (tail_size > 0) {
+            // the tail buffer is circular, starting at the byte after the head
+            const char* tail = ring->data + ring->head_bytes;
+            size_t start = (output.size - tail_size - ring->head_bytes) % ring->tail_bytes;
+            size_t first = std::min(tail_size, ring->tail_bytes - start);
+            output.tail.assign(tail + start, first);
+            output.tail.append(tail, tail_size - first);
+        }
+
+        tests++;
+        bytes += output.size;
+        dropped += output.dropped();
+        return output;
+    }
+
+    /*
+     * While in scope, output goes to the real stdout and stderr, e.g. for
+     * the harness's own messages in the middle of a test.
+     */
+    class Bypass {
+    public:
+        Bypass() : active(instance().capturing()) {
+            if (active) {
+                instance().flush();
+                instance().redirect(instance().real_out, instance().real_err);
+            }
+        }
+
+        ~Bypass() {
+            if (active) {
+                instance().flush();
+                instance().redirect(instance().sink, instance().sink);
+            }
+        }
+
+    private:
+        bool active;
+    };
+
+    /*!
+     * Totals over every captured test, e.g. "captured 1024 bytes from 3 tests, dropped 0".
+     */
+    std::string summary() const {
+        return "captured " + std::to_string(bytes) + " bytes from " + std::to_string(tests) +
+               " tests, dropped " + std::to_string(dropped);
+    }
+
+private:
+
+    /*
+     * What the reader shares with the test program.
+     */
+    struct Ring {
+        size_t head_bytes;
+        size_t tail_bytes;
+        size_t total;       // bytes read since the last RESET
+        char data[];        // the head, then the circular tail
+    };
+
+    enum Request : char {
+        RESET = 'r',        // drop what was read, for the next test
+        DRAIN = 'd'         // read everything written so far
+    };
+
+    int sink = -1;          // the write end of the pipe
+    int requests = -1;      // socket to the reader
+    pid_t reader = -1;
+    Ring* ring = NULL;
+    size_t ring_bytes = 0;
+    int real_out = -1;
+    int real_err = -1;
+    bool active = false;
+    long tests = 0;
+    long bytes = 0;
+    long dropped = 0;
+
+    OutputCapture() {}
+
+    void flush() {
+        std::cout.flush();
+        std::cerr.flush();
+        fflush(stdout);
+        fflush(stderr);
+    }
+
+    void redirect(int out, int err) {
+        dup2(out, STDOUT_FILENO);
+        dup2(err, STDERR_FILENO);
+    }
+
+    /*!
+     * Send a request to the reader and wait until it is done. The pipe
+     * holds everything written before, so once drained, the ring has it.
+     */
+    bool request(Request what) {
+        char reply;
+        if (write(requests, &what, 1) != 1) {
+            return false;
+        }
+        while (read(requests, &reply, 1) < 0) {
+            if (errno != EINTR) {
+                return false;
+            }
+        }
+        return reply == what;
+    }
+
+    /*!
+     * The reader process: copies the pipe into the ring until the test
+     * program goes away. Only calls async-signal-safe functions, since it is
+     * forked from a process that may have other threads. Never returns.
+     */
+    static void read_output(int pipe_out, int control, Ring* ring) {
+        prctl(PR_SET_PDEATHSIG, SIGKILL);
+        fcntl(pipe_out, F_SETFL, O_NONBLOCK);
+        struct pollfd fds[2] = {{pipe_out, POLLIN, 0}, {control, POLLIN, 0}};
+        while (true) {
+            if (poll(fds, 2, -1) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                _exit(1);
+            }
+            if (fds[0].revents & POLLIN) {
+                drain(pipe_out, ring);
+            }
+            if (fds[1].revents & (POLLIN | POLLHUP)) {
+                char what;
+                if (read(control, &what, 1) != 1) {
+                    _exit(0);
+                }
+                drain(pipe_out, ring);
+                if (what == RESET) {
+                    ring->total = 0;
+                }
+                if (write(control, &what, 1) != 1) {
+                    _exit(0);
+                }
+            }
+        }
+    }
+
+    /*!
+     * Read the pipe until it is empty, keeping the head and the tail.
+     */
+    static void drain(int pipe_out, Ring* ring) {
+        char chunk[65536];
+        ssize_t n;
+        while ((n = read(pipe_out, chunk, sizeof(chunk))) > 0 || (n < 0 && errno == EINTR)) {
+            const char* from = chunk;
+            size_t left = n > 0 ? n : 0;
+            if (ring->total < ring->head_bytes) {
+                size_t count = std::min(left, ring->head_bytes - ring->total);
+                memcpy(ring->data + ring->total, from, count);
+                ring->total += count;
+                from += count;
+                left -= count;
+            }
+            if (ring->tail_bytes == 0) {
+                ring->total += left;
+                continue;
+            }
+            // only the last tail_bytes of the chunk can survive
+            if (left > ring->tail_bytes) {
+                ring->total += left - ring->tail_bytes;
+                from += left - ring->tail_bytes;
+                left = ring->tail_bytes;
+            }
+            char* tail = ring->data + ring->head_bytes;
+            while (left > 0) {
+                size_t at = (ring->total - ring->head_bytes) % ring->tail_bytes;
+                size_t count = std::min(left, ring->tail_bytes - at);
+                memcpy(tail + at, from, count);
+                ring->total += count;
+                from += count;
+                left -= count;
+            }
+        }
+    }
+};
+
+#endif //ECE590_OUTPUT_CAPTURE_H
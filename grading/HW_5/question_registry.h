@@ -0,0 +1,217 @@
+// Registry of graded questions and their pass/fail tallies.
+
+#ifndef ECE590_QUESTION_REGISTRY_H
+#define ECE590_QUESTION_REGISTRY_H
+
+#include <atomic>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define TALLYPATTERN "QUESTION_TALLY:" // prefix of serialized tallies
+#define SKIPPEDPROPERTY "grade_skipped" // test property naming why a test is left out of the grade
+
+/*
+ * Tallies of one question. The counters are atomic so tests of the
+ * same question may run concurrently.
+ */
+struct QuestionTally {
+    int id;
+    std::string name;
+    double points;
+    std::atomic<int> num_tests;
+    std::atomic<int> num_passed;
+
+    QuestionTally(int id, const std::string& name, double points)
+            : id(id), name(name), points(points), num_tests(0), num_passed(0) {}
+
+    /*!
+     * Points earned so far.
+     */
+    double grade() const {
+        int tests = num_tests;
+        return tests > 0 ? (double) num_passed / tests * points : 0.0;
+    }
+};
+
+/*
+ * Every question registers itself here during static initialization (see
+ * GRADE_QUESTION in unit_tests.cc) with a unique id and its point value.
+ * Grades are always summed in id order, so the weighted grade does not depend
+ * on the order tests ran or results were merged.
+ *
+ * Tallies from other worker processes (e.g. Google Test shards) can be merged
+ * in from their serialized QUESTION_TALLY lines.
+ */
+class QuestionRegistry {
+public:
+
+    /*
+     * Tests passed and run by the workers merged in so far.
+     */
+    std::atomic<int> merged_passed;
+    std::atomic<int> merged_tests;
+
+    static QuestionRegistry& instance() {
+        static QuestionRegistry registry;
+        return registry;
+    }
+
+    /*!
+     * Register a question.
+     * @param id unique id, also the position in the grade breakdown
+     * @param name
+     * @param points weight of the question
+     * @return id
+     */
+    int add(int id, const std::string& name, double points) {
+        std::lock_guard<std::mutex> lock(mutex);
+        questions[id].reset(new QuestionTally(id, name, points));
+        return id;
+    }
+
+    /*!
+     * A new registry with the same questions and no tallies, e.g. for one
+     * version of the suite.
+     */
+    std::unique_ptr<QuestionRegistry> empty_copy() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::unique_ptr<QuestionRegistry> copy(new QuestionRegistry());
+        for (auto& q : questions) {
+            copy->add(q.first, q.second->name, q.second->points);
+        }
+        return copy;
+    }
+
+    /*!
+     * Tally of a registered question.
+     * @param id
+     * @return
+     */
+    QuestionTally& question(int id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto q = questions.find(id);
+        if (q == questions.end()) {
+            throw std::out_of_range("Question " + std::to_string(id) + " is not registered");
+        }
+        return *q->second;
+    }
+
+    /*!
+     * Ids of the registered questions, in order.
+     */
+    std::vector<int> ids() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<int> result;
+        for (auto& q : questions) {
+            result.push_back(q.first);
+        }
+        return result;
+    }
+
+    /*!
+     * Points earned for each question, in id order.
+     */
+    std::vector<double> question_grades() {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<double> grades;
+        for (auto& q : questions) {
+            grades.push_back(q.second->grade());
+        }
+        return grades;
+    }
+
+    /*!
+     * Fraction of the total points earned.
+     */
+    double grade() {
+        std::lock_guard<std::mutex> lock(mutex);
+        double earned = 0, total = 0;
+        for (auto& q : questions) {
+            if (q.second->num_tests > 0) {
+                earned += q.second->grade();
+                total += q.second->points;
+            }
+        }
+        return total > 0 ? earned / total : 0.0;
+    }
+
+    /*!
+     * Tests passed and run over all questions.
+     */
+    std::pair<int, int> totals() {
+        std::lock_guard<std::mutex> lock(mutex);
+        int passed = 0, tests = 0;
+        for (auto& q : questions) {
+            passed += q.second->num_passed;
+            tests += q.second->num_tests;
+        }
+        return std::make_pair(passed, tests);
+    }
+
+    /*!
+     * One "QUESTION_TALLY: <id> <name> <passed>/<tests> <points>" line per
+     * question, or "<pattern> <id> ..." if another pattern is given.
+     */
+    std::string serialize(const std::string& pattern = TALLYPATTERN) {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::ostringstream out;
+        for (auto& q : questions) {
+            out << pattern << " " << q.first << " " << q.second->name << " "
+                << q.second->num_passed << "/" << q.second->num_tests << " "
+                << q.second->points << "\n";
+        }
+        return out.str();
+    }
+
+    /*!
+     * Add the tallies serialized by another worker. Lines that are not
+     * tallies are ignored, so a whole test log can be merged.
+     * @param text
+     */
+    void merge(std::istream& text) {
+        std::string line;
+        while (std::getline(text, line)) {
+            std::istringstream fields(line);
+            std::string prefix, name;
+            int id, passed, tests;
+            char slash;
+            double points;
+            if (!(fields >> prefix >> id >> name >> passed >> slash >> tests >> points) || prefix != TALLYPATTERN) {
+                continue;
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            auto& q = questions[id];
+            if (!q) {
+                q.reset(new QuestionTally(id, name, points));
+            }
+            q->num_passed += passed;
+            q->num_tests += tests;
+            merged_passed += passed;
+            merged_tests += tests;
+        }
+    }
+
+    /*!
+     * Merge the tallies found in a file.
+     * @param path
+     */
+    void merge(const std::string& path) {
+        std::ifstream infile(path);
+        merge(infile);
+    }
+
+private:
+    std::mutex mutex;
+    std::map<int, std::unique_ptr<QuestionTally>> questions;
+
+    QuestionRegistry() : merged_passed(0), merged_tests(0) {}
+};
+
+#endif //ECE590_QUESTION_REGISTRY_H
@@ -0,0 +1,207 @@
+// Repro bundles: everything needed to rerun one failed test on its own.
+
+#ifndef ECE590_REPRO_H
+#define ECE590_REPRO_H
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "case_generator.h"
+
+/*
+ * Seeds rand() at the start of every test from the run's seed and the
+ * test's full name, so a test draws the same data whether the whole suite
+ * runs or only that test does.
+ *
+ * When enabled, each failed test also leaves a bundle in "<dir>/<test>",
+ * with '/' in the test name replaced by '_':
+ *
+ *   repro.txt  the test, its parameter, seeds, failures and the command
+ *   args       the arguments of that command, one per line
+ *   <files>    every file in the working directory the test wrote
+ *
+ * The command reruns only that test, with the same cases and data, from
+ * the same directory as the original run.
+ *
+ * Flag: --grade_repro=<dir>.
+ */
+class Repro {
+public:
+
+    static Repro& instance() {
+        static Repro repro;
+        return repro;
+    }
+
+    /*!
+     * Write bundles to "dir". The arguments are those left to the program
+     * after InitGoogleTest, which the bundle's command repeats.
+     */
+    void enable(const std::string& dir, int argc, char** argv) {
+        root = dir;
+        mkdir(root.c_str(), 0755);
+        args.clear();
+        bool seeded = false;
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg.compare(0, 13, "--grade_repro") == 0 || arg.compare(0, 13, "--grade_merge") == 0 ||
+                    arg.compare(0, 14, "--grade_events") == 0) {
+                continue;
+            }
+            seeded = seeded || arg.compare(0, 12, "--grade_seed") == 0;
+            args.push_back(arg);
+        }
+        if (!seeded) {
+            args.push_back("--grade_seed=" + std::to_string(CaseGenerator::seed()));
+        }
+    }
+
+    bool enabled() const {
+        return !root.empty();
+    }
+
+    /*!
+     * The rand() seed of a test: FNV-1a of its full name, mixed with the
+     * run's seed.
+     */
+    static unsigned test_seed(const ::testing::TestInfo& info) {
+        unsigned hash = 2166136261u ^ CaseGenerator::seed();
+        for (const char c : full_name(info)) {
+            hash = (hash ^ (unsigned char) c) * 16777619u;
+        }
+        return hash;
+    }
+
+    static std::string full_name(const ::testing::TestInfo& info) {
+        return std::string(info.test_case_name()) + "." + info.name();
+    }
+
+    /*!
+     * Called as each test starts, before its fixture is constructed.
+     */
+    void begin(const ::testing::TestInfo& info) {
+        srand(test_seed(info));
+        if (enabled()) {
+            clock_gettime(CLOCK_REALTIME_COARSE, &started); // the clock file times are taken from
+            remove_bundle(bundle_dir(info)); // left by an earlier run of the same test
+        }
+    }
+
+    /*!
+     * Called as each test ends. Writes the bundle of a failed test and
+     * returns its directory, or "" if there is none.
+     */
+    std::string end(const ::testing::TestInfo& info) {
+        if (!enabled() || !info.result()->Failed()) {
+            return "";
+        }
+        std::string dir = bundle_dir(info);
+        mkdir(dir.c_str(), 0755);
+
+        std::vector<std::string> files = written_files();
+        for (const std::string& file : files) {
+            std::ifstream in(file, std::ios::binary);
+            std::ofstream out(dir + "/" + file, std::ios::binary);
+            out << in.rdbuf();
+        }
+
+        std::ofstream arguments(dir + "/args");
+        arguments << "--gtest_filter=" << full_name(info) << "\n";
+        for (const std::string& arg : args) {
+            arguments << arg << "\n";
+        }
+
+        std::ofstream txt(dir + "/repro.txt");
+        txt << "test:    " << full_name(info) << "\n";
+        if (info.value_param() != NULL) {
+            txt << "param:   " << info.value_param() << "\n";
+        }
+        if (info.type_param() != NULL) {
+            txt << "type:    " << info.type_param() << "\n";
+        }
+        txt << "seed:    " << CaseGenerator::seed() << " (rand() seeded with " << test_seed(info) << ")\n";
+        txt << "files:  ";
+        for (const std::string& file : files) {
+            txt << " " << file;
+        }
+        txt << "\ncommand: bin/test '--gtest_filter=" << full_name(info) << "'";
+        for (const std::string& arg : args) {
+            txt << " '" << arg << "'";
+        }
+        txt << "\n\n";
+        const ::testing::TestResult* result = info.result();
+        for (int i = 0; i < result->total_part_count(); i++) {
+            const ::testing::TestPartResult& part = result->GetTestPartResult(i);
+            if (part.failed()) {
+                txt << (part.file_name() ? part.file_name() : "unknown") << ":" << part.line_number() << "\n"
+                    << part.summary() << "\n\n";
+            }
+        }
+        return dir;
+    }
+
+private:
+
+    std::string root;
+    std::vector<std::string> args;
+    struct timespec started = {0, 0};
+
+    std::string bundle_dir(const ::testing::TestInfo& info) const {
+        std::string name = full_name(info);
+        for (char& c : name) {
+            c = c == '/' ? '_' : c;
+        }
+        return root + "/" + name;
+    }
+
+    /*!
+     * Regular files in the working directory modified since the test began,
+     * except the log the run itself writes to.
+     */
+    std::vector<std::string> written_files() const {
+        std::vector<std::string> files;
+        DIR* dir = opendir(".");
+        if (dir == NULL) {
+            return files;
+        }
+        struct stat out, err;
+        fstat(STDOUT_FILENO, &out);
+        fstat(STDERR_FILENO, &err);
+        while (struct dirent* entry = readdir(dir)) {
+            struct stat st;
+            if (stat(entry->d_name, &st) < 0 || !S_ISREG(st.st_mode) ||
+                    (st.st_dev == out.st_dev && st.st_ino == out.st_ino) ||
+                    (st.st_dev == err.st_dev && st.st_ino == err.st_ino)) {
+                continue;
+            }
+            if (st.st_mtim.tv_sec > started.tv_sec ||
+                    (st.st_mtim.tv_sec == started.tv_sec && st.st_mtim.tv_nsec >= started.tv_nsec)) {
+                files.push_back(entry->d_name);
+            }
+        }
+        closedir(dir);
+        return files;
+    }
+
+    static void remove_bundle(const std::string& path) {
+        DIR* dir = opendir(path.c_str());
+        if (dir == NULL) {
+            return;
+        }
+        while (struct dirent* entry = readdir(dir)) {
+            unlink((path + "/" + entry->d_name).c_str());
+        }
+        closedir(dir);
+        rmdir(path.c_str());
+    }
+};
+
+#endif //ECE590_REPRO_H
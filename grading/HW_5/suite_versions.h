@@ -0,0 +1,171 @@
+// Several versions of the test suite graded by one run.
+
+#ifndef ECE590_SUITE_VERSIONS_H
+#define ECE590_SUITE_VERSIONS_H
+
+#include <stdio.h>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "gtest/gtest.h"
+#include "question_registry.h"
+
+#define VERSIONDELIM " %%:%% "          // separates a version from its filter
+#define VERSIONTALLYPATTERN "VERSION_TALLY:" // prefix of serialized version tallies
+#define VERSIONGRADEPATTERN "VERSION_GRADE:" // prefix of each version's grade
+
+// Versions of the suite, each a Google Test filter over the tests compiled
+// into this binary, read from "<version> %%:%% <filter>" lines:
+//
+//   original %%:%% *-ReadTests/ReadBrokenTests.ReadRandomBrokenCSV_v2/*
+//   revised  %%:%% *-ReadTests/ReadBrokenTests.ReadRandomBrokenCSV/*
+//
+// A revised test is added next to the one it replaces, under another name,
+// and each version leaves out the other's. Every test still runs once, and
+// its result counts towards each version whose filter selects it, in that
+// version's own QuestionRegistry. So one run grades every version with the
+// same student build and the same generated cases.
+//
+// Flag: --grade_versions=<file>.
+class SuiteVersions {
+public:
+
+    static SuiteVersions& instance() {
+        static SuiteVersions versions;
+        return versions;
+    }
+
+    /*!
+     * Read the versions from "path". Must be called once every question is
+     * registered.
+     */
+    void load(const std::string& path) {
+        std::ifstream infile(path);
+        std::string line;
+        while (std::getline(infile, line)) {
+            size_t n = line.find(VERSIONDELIM);
+            if (line.empty() || line[0] == '#' || n == std::string::npos) {
+                continue;
+            }
+            Version version;
+            version.name = line.substr(0, n);
+            version.filter = line.substr(n + std::string(VERSIONDELIM).size());
+            version.registry = QuestionRegistry::instance().empty_copy();
+            versions.push_back(std::move(version));
+        }
+    }
+
+    bool enabled() const {
+        return !versions.empty();
+    }
+
+    /*!
+     * Count the result of a test of question "id" in each version that
+     * selects it.
+     */
+    void record(const ::testing::TestInfo& info, int id, bool passed) {
+        std::string name = std::string(info.test_case_name()) + "." + info.name();
+        for (Version& version : versions) {
+            if (matches_filter(name, version.filter)) {
+                QuestionTally& tally = version.registry->question(id);
+                tally.num_tests++;
+                tally.num_passed += passed;
+            }
+        }
+    }
+
+    /*!
+     * Add the version tallies in the log of another worker.
+     * @param path
+     */
+    void merge(const std::string& path) {
+        std::ifstream infile(path);
+        std::string line;
+        while (std::getline(infile, line)) {
+            std::istringstream fields(line);
+            std::string prefix, name, rest;
+            if (!(fields >> prefix >> name) || prefix != VERSIONTALLYPATTERN) {
+                continue;
+            }
+            std::getline(fields, rest);
+            for (Version& version : versions) {
+                if (version.name == name) {
+                    std::istringstream tally(std::string(TALLYPATTERN) + rest);
+                    version.registry->merge(tally);
+                }
+            }
+        }
+    }
+
+    /*!
+     * Per version, its question tallies and a
+     * "VERSION_GRADE: <version> <passed>/<tests> <weighted grade>" line.
+     */
+    std::string report() {
+        std::ostringstream out;
+        for (Version& version : versions) {
+            out << version.registry->serialize(std::string(VERSIONTALLYPATTERN) + " " + version.name);
+        }
+        for (Version& version : versions) {
+            std::pair<int, int> totals = version.registry->totals();
+            out << VERSIONGRADEPATTERN << " " << version.name << " " << totals.first << "/" << totals.second
+                << " " << version.registry->grade() * 100.0 << "\n";
+        }
+        return out.str();
+    }
+
+    /*!
+     * Whether a Google Test filter, "positive[-negative]" with ':'
+     * separated patterns of '*' and '?' wildcards, selects "name".
+     */
+    static bool matches_filter(const std::string& name, const std::string& filter) {
+        size_t dash = filter.find('-');
+        std::string positive = filter.substr(0, dash);
+        if (positive.empty()) {
+            positive = "*";
+        }
+        if (!matches_any(name, positive)) {
+            return false;
+        }
+        return dash == std::string::npos || !matches_any(name, filter.substr(dash + 1));
+    }
+
+private:
+
+    struct Version {
+        std::string name;
+        std::string filter;
+        std::unique_ptr<QuestionRegistry> registry; // this version's tallies
+    };
+
+    std::vector<Version> versions;
+
+    static bool matches_any(const std::string& name, const std::string& patterns) {
+        std::stringstream list(patterns);
+        std::string pattern;
+        while (std::getline(list, pattern, ':')) {
+            if (matches(name.c_str(), pattern.c_str())) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static bool matches(const char* name, const char* pattern) {
+        switch (*pattern) {
+            case '\0':
+                return *name == '\0';
+            case '?':
+                return *name != '\0' && matches(name + 1, pattern + 1);
+            case '*':
+                return (*name != '\0' && matches(name + 1, pattern)) || matches(name, pattern + 1);
+            default:
+                return *name == *pattern && matches(name + 1, pattern + 1);
+        }
+    }
+};
+
+#endif //ECE590_SUITE_VERSIONS_H
@@ -10,6 +10,17 @@
 #include "typed_matrix.h"
 #include <fstream>
 #include "gtestnodeath.h"
+#include "case_generator.h"
+#include "question_registry.h"
+#include "alloc_counter.h"
+#include "value_semantics.h"
+#include "complexity.h"
+#include "benchmark.h"
+#include "answer_key.h"
+#include "suite_versions.h"
+#include "grade_events.h"
+#include "fuzz.h"
+#include "matrix_compare.h"
 #include <vector>
 
 
@@ -24,7 +35,14 @@ using std::vector;
 #define Q3POINTS 100.0
 #define Q4POINTS 100.0
 #define Q5POINTS 100.0
-#define NUM_QUESTIONS 5 // overestimated number of questions
+#define Q1BUDGET_MS 1000.0 // time budgets for generated test cases
+#define Q2BUDGET_MS 4000.0
+#define Q3BUDGET_MS 3000.0
+#define Q4BUDGET_MS 1000.0
+#define Q3FUZZ_EXECUTIONS 5000 // inputs each FuzzReadTests instance runs
+#define FORK_MS 2.0 // estimated cost of one death test fork
+#define CELL_MS 0.001 // estimated cost of filling or checking one matrix cell
+#define CSV_CELL_MS 0.005 // estimated cost of writing and parsing one csv cell
 #define GTEST_COUT_GRADE std::cerr       << "[    GRADE ] "
 
 /*
@@ -99,7 +117,7 @@ protected:
      */
     TypedMatrix<int> int_typed_matrix(const vector<vector<int>> &v) {
         int rows = v.size(),
-                cols;
+                cols = 0;
         if (rows > 0) {
             cols = v[0].size();
         }
@@ -129,7 +147,7 @@ protected:
      */
     TypedMatrix<double> dbl_typed_matrix(const vector<vector<double>> &v) {
         int rows = v.size(),
-            cols;
+            cols = 0;
         if (rows > 0) {
             cols = v[0].size();
         }
@@ -427,59 +445,59 @@ protected:
 /*
  * Define the base test classes for each of the questions.
  *
- * Each question should inherit from the main Question base,
- * which holds three static vectors (number of tests, number of
- * passing tests, total point value). Each inherited class
- * should get its own unique integer id. To get the number of tests,
- * number of passing tests, or total point values for a question,
- * just access the static vectors with the corresponding unique
- * int id.
+ * Each question should inherit from the main Question base and is
+ * declared with GRADE_QUESTION, which registers it with the
+ * QuestionRegistry under its own unique integer id and point value.
+ * The registry keeps the number of tests and number of passing tests
+ * of each question in atomic counters, which are computed automatically.
  *
  * The individual weights for each question can be adjusted via
- * the "totals" static vector. The number of tests and number
- * of passing tests are computed automatically.
+ * the point value passed to GRADE_QUESTION.
  *
  * To get the total grade, call "grade()". To get a grade break down
  * of each question, call "question_grades()".
  */
 
 class Question : public BaseTest {
-public:
-    static vector<int> num_tests;
-    static vector<int> num_passed;
-    static vector<double> totals;
-
 protected:
-    int total_points;
     int id = -1;
+    bool skipped = false; // failed by FailFast without running
+    bool uncounted = false; // left out of the grade by skip_uncounted()
+    std::unique_ptr<AllocationScope> allocations; // allocations of the test body
 
-    Question() {
-        num_tests.resize(NUM_QUESTIONS);
-        num_passed.resize(NUM_QUESTIONS);
-        totals.resize(NUM_QUESTIONS);
+    explicit Question(int id) : id(id) {
+        QuestionRegistry::instance().question(id).num_tests++;
+        GradeEvents::instance().set_question(id);
     }
 
-    virtual vector<double> question_grades() {
-        vector<double> grade;
-        grade.resize(NUM_QUESTIONS);
-        for (int i = 0; i < NUM_QUESTIONS; i++) {
-            if (totals[i] > 0) {
-                grade[i] = (double) num_passed[i]/num_tests[i] * totals[i];
-            }
+    virtual void SetUp() {
+        string reason;
+        const ::testing::TestInfo* info = ::testing::UnitTest::GetInstance()->current_test_info();
+        if (FailFast::instance().should_skip(*info, &reason)) {
+            skipped = true;
+            FAIL() << reason;
         }
-        return grade;
+        allocations.reset(new AllocationScope());
     }
 
-    virtual double grade() {
+    /*!
+     * Leave the current test out of the grade, e.g. when what it grades is
+     * not measured in this build. The test body should return right after.
+     * The listener prints the reason and counts the test neither way.
+     * @param reason
+     */
+    void skip_uncounted(const string& reason) {
+        uncounted = true;
+        QuestionRegistry::instance().question(id).num_tests--;
+        RecordProperty(SKIPPEDPROPERTY, reason);
+    }
 
-        double t, v;
-        for (int i = 0; i < NUM_QUESTIONS; i++) {
-            if (totals[i] > 0) {
-                v += (double) num_passed[i]/num_tests[i] * totals[i];
-                t += totals[i];
-            }
-        }
-        return v/t;
+    virtual vector<double> question_grades() {
+        return QuestionRegistry::instance().question_grades();
+    }
+
+    virtual double grade() {
+        return QuestionRegistry::instance().grade();
     }
 
     void print_grade() {
@@ -492,60 +510,66 @@ protected:
     }
 
     virtual void TearDown() {
+        AllocationCounter::test_stats() = allocations ? allocations->stop() : AllocationStats();
+        if (uncounted) {
+            print_grade();
+            return;
+        }
         if (!HasFailure()) {
-            num_passed[id]++;
+            QuestionRegistry::instance().question(id).num_passed++;
+        }
+        const ::testing::TestInfo* info = ::testing::UnitTest::GetInstance()->current_test_info();
+        SuiteVersions::instance().record(*info, id, !HasFailure());
+        if (!skipped) {
+            FailFast::instance().record_result(*info, HasFailure());
         }
         print_grade();
     }
 };
 
-vector<int> Question::num_tests;
-vector<int> Question::num_passed;
-vector<double> Question::totals;
-// get number of questions
+/*
+ * Declares the base test class "name" of a question and registers it
+ * with the given id and point value at static initialization.
+ */
+#define GRADE_QUESTION(name, qid, points) \
+    class name : public Question { \
+    protected: \
+        name() : Question(qid) {} \
+    }; \
+    static const int name##_id_ = QuestionRegistry::instance().add(qid, #name, points)
+
+GRADE_QUESTION(Question1, 0, Q1POINTS);
+GRADE_QUESTION(Question2, 1, Q2POINTS);
+GRADE_QUESTION(Question3, 2, Q3POINTS);
+GRADE_QUESTION(Question4, 3, Q4POINTS);
+GRADE_QUESTION(Question5, 4, Q5POINTS);
 
-class Question1 : public Question {
+/*
+ * Base class of the tests of question "Q" that time student code with
+ * benchmark.h. The budget of each benchmark scales with the run's budget
+ * (--grade_budget), and every result is logged after the test.
+ */
+template <class Q>
+class BenchmarkTest : public Q {
 protected:
-    Question1() {
-        id = 0;
-        totals[id] = Q1POINTS;
-        num_tests[id]++;
-    }
-};
+    Benchmark benchmark;
 
-class Question2 : public Question {
-protected:
-    Question2() {
-        id = 1;
-        totals[id] = Q2POINTS;
-        num_tests[id]++;
+    BenchmarkTest() {
+        benchmark.budget_ms *= CaseGenerator::budget_scale();
     }
-};
 
-class Question3 : public Question {
-protected:
-    Question3() {
-        id = 2;
-        totals[id] = Q3POINTS;
-        num_tests[id]++;
+    template <typename Run>
+    BenchmarkResult measure(const string& name, Run run) {
+        BenchmarkResult result = benchmark.measure(name, run);
+        Benchmark::record(result);
+        return result;
     }
-};
 
-class Question4 : public Question {
-protected:
-    Question4() {
-        id = 3;
-        totals[id] = Q4POINTS;
-        num_tests[id]++;
-    }
-};
-
-class Question5 : public Question {
-protected:
-    Question5() {
-        id = 4;
-        totals[id] = Q5POINTS;
-        num_tests[id]++;
+    template <typename Run, typename Reference>
+    BenchmarkResult compare(const string& name, Run run, Reference reference) {
+        BenchmarkResult result = benchmark.compare(name, run, reference);
+        Benchmark::record(result);
+        return result;
     }
 };
 
@@ -595,14 +619,75 @@ TEST_P(SortTests, SortByMag) {
     }
 };
 
+/*
+ * Vector sizes for SortTests: empty and tiny vectors plus sizes spread
+ * evenly over each power of two up to 100000.
+ */
+vector<int> sort_cases() {
+    // Google Test asks for the cases once per TEST_P, so only draw them once
+    static vector<int> cases = CaseGenerator::generate<int>(
+            "Question1", "SortTests", Q1BUDGET_MS,
+        [](CaseGenerator::Random& random) {
+            return random.chance(0.2) ? random.uniform(0, 2) : random.log_uniform(3, 100000);
+        },
+        [](int size) {
+            return 0.05 + size * 0.002;
+        });
+    return cases;
+}
+
 /*
  * parameterizes the SortTests, TEST_P class above.
  */
 INSTANTIATE_TEST_CASE_P(SortTests,
         SortTests,
-        ::testing::Range(0, 1000, 100) // size of the first array
+        ::testing::ValuesIn(sort_cases()) // size of the first array
 );
 
+class SortComplexityTests : public Question1 {
+};
+
+/*
+ * sort_by_magnitude should be an n log n sort, such as std::sort.
+ * Each run sorts a fresh random vector, so an in-place sort is
+ * never handed sorted input.
+ */
+TEST_F(SortComplexityTests, SortByMagnitudeGrowth) {
+    ComplexityFit fit = Complexity().measure(
+        [this](int n) {
+            return dbl_vector(n, -100.0, 100.0);
+        },
+        [](vector<double>& x) {
+            vector<double> sorted = sort_by_magnitude(x);
+        });
+    EXPECT_COMPLEXITY_AT_MOST(fit, N_LOG_N);
+}
+
+class SortBenchmarkTests : public BenchmarkTest<Question1> {
+};
+
+/*
+ * sort_by_magnitude should be about as fast as sorting a copy with
+ * std::sort and a lambda. It may take twice as long, e.g. for an extra
+ * copy, before the test fails.
+ */
+TEST_F(SortBenchmarkTests, SortByMagnitudeSpeed) {
+    vector<double> x = dbl_vector(10000, -100.0, 100.0);
+    BenchmarkResult result = compare("sort_by_magnitude",
+        [&x]() {
+            vector<double> y = x;
+            vector<double> sorted = sort_by_magnitude(y);
+            Benchmark::keep(sorted);
+        },
+        [&x]() {
+            vector<double> y = x;
+            vector<double> sorted = y;
+            std::sort(sorted.begin(), sorted.end(), [](double a, double b) { return fabs(a) < fabs(b); });
+            Benchmark::keep(sorted);
+        });
+    EXPECT_WITHIN_PERCENT_OF_REFERENCE(result, 100);
+}
+
 /*
  * Question 2 *************************************************
  * Rewrite the TypedMatrix class with vectors instead of TypedArrays.
@@ -657,11 +742,7 @@ TEST_P(MatrixTests, TypedMatrixEmptyConstructor) {
     CheckNoDeathWithDeath(m, r, c);
 
     if (check_values == 1) {
-        for (int i = 0; i < r; i++) {
-            for (int j = 0; j < c; j++) {
-                ASSERT_DOUBLE_EQ(m.get(i, j), double());
-            }
-        }
+        ASSERT_MATRIX_NEAR(m, vector<vector<double>>(r, vector<double>(c, double())), MatrixTolerance::ulps(4));
     } else if (check_values == 2) {
         CheckOutOfBounds(m, r, c);
     }
@@ -681,11 +762,7 @@ TEST_P(MatrixTests, TypedMatdbl_typed_matrixrixRandomDoubleConstructor) {
     CheckNoDeathWithDeath(m, r, c);
 
     if (check_values == 1) {
-        for (int i = 0; i < r; i++) {
-            for (int j = 0; j < c; j++) {
-                ASSERT_DOUBLE_EQ(m.get(i, j), x[i][j]);
-            }
-        }
+        ASSERT_MATRIX_NEAR(m, x, MatrixTolerance::ulps(4));
     } else if (check_values == 2) {
         CheckOutOfBounds(m, r, c);
     }
@@ -707,11 +784,7 @@ TEST_P(MatrixTests, TypedMatrixRandomIntConstructor) {
     CheckNoDeathWithDeath(m, r, c);
 
     if (check_values == 1) {
-        for (int i = 0; i < r; i++) {
-            for (int j = 0; j < c; j++) {
-                ASSERT_EQ(m.get(i, j), x[i][j]);
-            }
-        }
+        ASSERT_MATRIX_NEAR(m, x, MatrixTolerance::absolute(0));
     } else if (check_values == 2) {
         CheckOutOfBounds(m, r, c);
     }
@@ -734,11 +807,7 @@ TEST_P(MatrixOperatorTests, Copy) {
     TypedMatrix<double> a;
     a = m;
 
-    for (int i = 0; i < r; i++) {
-        for (int j = 0; j < c; j++) {
-            ASSERT_EQ(m.get(i, j), a.get(i, j));
-        }
-    }
+    ASSERT_MATRIX_NEAR(a, m, MatrixTolerance::absolute(0));
 };
 
 TEST_P(MatrixOperatorTests, Add) {
@@ -758,13 +827,13 @@ TEST_P(MatrixOperatorTests, Add) {
     TypedMatrix<double> m2 = dbl_typed_matrix(x2);
     TypedMatrix<double> m3 = m1 + m2;
 
+    vector<vector<double>> expected = x1;
     for (int i = 0; i < r; i++) {
         for (int j = 0; j < c; j++) {
-            double expected = x1[i][j] + x2[i][j];
-            double v = m3.get(i, j);
-            ASSERT_NEAR(v, expected, DBL_PRECISION);
+            expected[i][j] += x2[i][j];
         }
     }
+    ASSERT_MATRIX_NEAR(m3, expected, MatrixTolerance::absolute(DBL_PRECISION));
 };
 
 TEST_P(MatrixOperatorTests, Equal) {
@@ -839,14 +908,13 @@ TEST_P(MatrixOperatorTests, MultAssign) {
     TypedMatrix<double> m2 = dbl_typed_matrix(x2);
     m1 *= m2;
 
-
+    vector<vector<double>> expected = x1;
     for (int i = 0; i < r; i++) {
         for (int j = 0; j < c; j++) {
-            double expected = x1[i][j] * x2[i][j];
-            double v = m1.get(i, j);
-            ASSERT_NEAR(v, expected, DBL_PRECISION);
+            expected[i][j] *= x2[i][j];
         }
     }
+    ASSERT_MATRIX_NEAR(m1, expected, MatrixTolerance::absolute(DBL_PRECISION));
 };
 
 TEST_P(MatrixOperatorTests, AddAssign) {
@@ -866,33 +934,188 @@ TEST_P(MatrixOperatorTests, AddAssign) {
     TypedMatrix<double> m2 = dbl_typed_matrix(x2);
     m1 += m2;
 
-
+    vector<vector<double>> expected = x1;
     for (int i = 0; i < r; i++) {
         for (int j = 0; j < c; j++) {
-            double expected = x1[i][j] + x2[i][j];
-            double v = m1.get(i, j);
-            ASSERT_NEAR(v, expected, DBL_PRECISION);
+            expected[i][j] += x2[i][j];
         }
     }
+    ASSERT_MATRIX_NEAR(m1, expected, MatrixTolerance::absolute(DBL_PRECISION));
+};
+
+
+
+/*
+ * Draws a matrix dimension in [min, max], a quarter of the time one
+ * of the edge sizes min, min + 1 or min + 2.
+ */
+int draw_dimension(CaseGenerator::Random& random, int min, int max) {
+    return random.chance(0.25) ? random.uniform(min, min + 2) : random.log_uniform(min + 3, max);
+}
+
+/*
+ * (rows, cols, check_values) for MatrixTests. Rows may be 0.
+ */
+vector<std::tuple<int, int, int>> matrix_cases() {
+    static vector<std::tuple<int, int, int>> cases = CaseGenerator::generate<std::tuple<int, int, int>>(
+            "Question2", "MatrixTests", Q2BUDGET_MS / 2,
+        [](CaseGenerator::Random& random) {
+            return std::make_tuple(draw_dimension(random, 0, 300),
+                                   draw_dimension(random, 1, 300),
+                                   random.uniform(0, 2));
+        },
+        [](const std::tuple<int, int, int>& c) {
+            return 3 * (2 * FORK_MS + 4 * std::get<0>(c) * std::get<1>(c) * CELL_MS);
+        });
+    return cases;
+}
+
+/*
+ * (rows, cols) for MatrixOperatorTests.
+ */
+vector<std::tuple<int, int>> matrix_operator_cases() {
+    static vector<std::tuple<int, int>> cases = CaseGenerator::generate<std::tuple<int, int>>(
+            "Question2", "MatrixOperatorTests", Q2BUDGET_MS / 3,
+        [](CaseGenerator::Random& random) {
+            return std::make_tuple(draw_dimension(random, 1, 200), draw_dimension(random, 1, 200));
+        },
+        [](const std::tuple<int, int>& c) {
+            return 6 * (FORK_MS + 6 * std::get<0>(c) * std::get<1>(c) * CELL_MS);
+        });
+    return cases;
+}
+
+/*
+ * Value semantics of TypedMatrix, graded by counting the element copies
+ * TypedMatrix<Counted> makes. Moving or returning a matrix should hand
+ * over its storage instead of copying every element. The matrices are
+ * built in value_semantics.cc, so a TypedMatrix that does not compile with
+ * Counted elements only fails these tests.
+ */
+class ValueSemanticsTests : public Question2,
+                    public ::testing::WithParamInterface<std::tuple<int, int>> {
+protected:
+
+    virtual void SetUp() {
+        Question2::SetUp();
+        ASSERT_TRUE(ValueSemantics::available()) << ValueSemantics::problem();
+    }
+};
+
+TEST_P(ValueSemanticsTests, MoveConstruct) {
+    std::tuple<int, int> params = GetParam();
+    int r = std::get<0>(params),
+        c = std::get<1>(params);
+    ASSERT_NO_DEATH({
+        ValueSemantics::move_construct(r, c, convention());
+    }, ".*");
+
+    long copies = ValueSemantics::move_construct(r, c, convention());
+    EXPECT_EQ(copies, 0) << "TypedMatrix b(std::move(a)) should not copy any element";
+};
+
+TEST_P(ValueSemanticsTests, MoveAssign) {
+    std::tuple<int, int> params = GetParam();
+    int r = std::get<0>(params),
+        c = std::get<1>(params);
+    ASSERT_NO_DEATH({
+        ValueSemantics::move_assign(r, c, convention());
+    }, ".*");
+
+    long copies = ValueSemantics::move_assign(r, c, convention());
+    EXPECT_EQ(copies, 0) << "b = std::move(a) should not copy any element";
 };
 
+TEST_P(ValueSemanticsTests, CopyAssign) {
+    std::tuple<int, int> params = GetParam();
+    int r = std::get<0>(params),
+        c = std::get<1>(params);
+    ASSERT_NO_DEATH({
+        ValueSemantics::copy_assign(r, c, convention());
+    }, ".*");
+
+    long copies = ValueSemantics::copy_assign(r, c, convention());
+    EXPECT_LE(copies, r * c) << "b = a should copy each element once";
+};
 
+TEST_P(ValueSemanticsTests, Return) {
+    std::tuple<int, int> params = GetParam();
+    int r = std::get<0>(params),
+        c = std::get<1>(params);
+    ASSERT_NO_DEATH({
+        ValueSemantics::return_by_value(r, c, convention());
+    }, ".*");
+
+    long copies = ValueSemantics::return_by_value(r, c, convention());
+    EXPECT_EQ(copies, 0) << "Returning a TypedMatrix by value should not copy any element";
+};
+
+TEST_P(ValueSemanticsTests, AddTemporary) {
+    std::tuple<int, int> params = GetParam();
+    int r = std::get<0>(params),
+        c = std::get<1>(params);
+    long add_copies, assign_copies;
+    ASSERT_NO_DEATH({
+        ValueSemantics::add_temporary(r, c, convention(), &add_copies, &assign_copies);
+    }, ".*");
+
+    ValueSemantics::add_temporary(r, c, convention(), &add_copies, &assign_copies);
+    EXPECT_LE(add_copies, 3 * r * c) << "m1 + m2 copies each element more than needed";
+    EXPECT_EQ(assign_copies, 0) << "m3 = m1 + m2 should move the temporary instead of copying it";
+};
+
+/*
+ * (rows, cols) for ValueSemanticsTests.
+ */
+vector<std::tuple<int, int>> value_semantics_cases() {
+    static vector<std::tuple<int, int>> cases = CaseGenerator::generate<std::tuple<int, int>>(
+            "Question2", "ValueSemanticsTests", Q2BUDGET_MS / 6,
+        [](CaseGenerator::Random& random) {
+            return std::make_tuple(draw_dimension(random, 1, 200), draw_dimension(random, 1, 200));
+        },
+        [](const std::tuple<int, int>& c) {
+            return 5 * (FORK_MS + 8 * std::get<0>(c) * std::get<1>(c) * CELL_MS);
+        });
+    return cases;
+}
+
+/*
+ * Adding in place should reuse the storage of the left matrix.
+ * Only graded when allocations are counted (make ALLOC=1). Otherwise it
+ * still runs, but skips itself and counts neither as passed nor as failed.
+ */
+TEST_P(MatrixOperatorTests, AddAssignDoesNotAllocate) {
+    if (!AllocationCounter::enabled()) {
+        skip_uncounted("allocations are not counted, build with ALLOC=1");
+        return;
+    }
+    std::tuple<int, int> params = GetParam();
+    int r = std::get<0>(params),
+            c = std::get<1>(params);
+    ASSERT_NO_DEATH({
+                        TypedMatrix<double> m1 = dbl_typed_matrix(r, c, -100, 100);
+                        TypedMatrix<double> m2 = dbl_typed_matrix(r, c, -100, 100);
+                        m1 += m2;
+                    }, ".*");
+
+    TypedMatrix<double> m1 = dbl_typed_matrix(r, c, -100, 100);
+    TypedMatrix<double> m2 = dbl_typed_matrix(r, c, -100, 100);
+    EXPECT_ALLOCATIONS_AT_MOST(m1 += m2, 0);
+};
 
 INSTANTIATE_TEST_CASE_P(MatrixTests,
         MatrixTests,
-        ::testing::Combine(
-            testing::Values(0, 1, 2, 10),
-            testing::Values(1, 2, 10),
-            testing::Values(0, 1, 2)
-        )
+        ::testing::ValuesIn(matrix_cases())
 );
 
 INSTANTIATE_TEST_CASE_P(MatrixOperatorTests,
         MatrixOperatorTests,
-        ::testing::Combine(
-            testing::Values(1, 1, 2, 10),
-            testing::Values(1, 2, 10)
-        )
+        ::testing::ValuesIn(matrix_operator_cases())
+);
+
+INSTANTIATE_TEST_CASE_P(ValueSemanticsTests,
+        ValueSemanticsTests,
+        ::testing::ValuesIn(value_semantics_cases())
 );
 
 /*
@@ -909,6 +1132,20 @@ INSTANTIATE_TEST_CASE_P(MatrixOperatorTests,
  * a row of the matrix. Place method in utilities.h and utilities.cc
  */
 
+/*
+ * Ways ReadBrokenTests corrupts a csv file.
+ */
+enum CsvCorruption {
+    EXTRA_CELL,     // one row gets an extra "1.0"
+    MISSING_CELL,   // one row loses its last value
+    BAD_TOKEN,      // one value is not a number
+    EMPTY_CELL,     // one value is blank
+    NUM_CORRUPTIONS
+};
+
+/*
+ * (rows, cols)
+ */
 class ReadTests : public Question3,
                     public ::testing::WithParamInterface<std::tuple<int, int>> {
 };
@@ -926,41 +1163,59 @@ TEST_P(ReadTests, ReadRandomCSV) {
     TypedMatrix<double> m = read_matrix_csv(path);
 
     int rows = x.size(),
-        cols;
+        cols = 0;
     if (rows > 0) {
-        CheckNoDeathWithDeath(m, rows, cols);
-    }
-    for (int i = 0; i < x.size(); i++) {
         cols = x[0].size();
-        for (int j = 0; j < cols; j++) {
-            ASSERT_NEAR(m.get(i, j), x[i][j], DBL_PRECISION);
-        }
+        CheckNoDeathWithDeath(m, rows, cols);
     }
+    ASSERT_MATRIX_NEAR(m, x, MatrixTolerance::absolute(DBL_PRECISION));
 }
 
 /*
- * Add extra double on one of the rows, which should compromise
+ * (rows, cols, corruption)
+ */
+class ReadBrokenTests : public Question3,
+                    public ::testing::WithParamInterface<std::tuple<int, int, int>> {
+};
+
+/*
+ * Corrupt one of the rows, which should compromise
  * the abilitiy to read the csv file.
  */
-TEST_P(ReadTests, ReadRandomBrokenCSV) {
-    std::tuple<int, int> params = GetParam();
+TEST_P(ReadBrokenTests, ReadRandomBrokenCSV) {
+    std::tuple<int, int, int> params = GetParam();
     int r = std::get<0>(params),
             c = std::get<1>(params);
+    int corruption = std::get<2>(params);
 
-    GTEST_COUT << "Rows: " << r << " Cols: " << c << std::endl;
+    GTEST_COUT << "Rows: " << r << " Cols: " << c << " Corruption: " << corruption << std::endl;
     vector<vector<double>> x = dbl_matrix(r, c, -1000.0, 1000.0);
     vector<vector<string>> s = to_vector_string(x);
 
     if (r > 0) {
         int i = random_int(0, r-1);
+        int j = random_int(0, c-1);
         vector<string>& row = s[i];
-        row.push_back("1.0");
+        int should_throw; // 1 yes, 0 no, -1 unspecified (a blank line)
+        if (corruption == EXTRA_CELL) {
+            row.push_back("1.0");
+            should_throw = r > 1; // a single row is still a matrix
+        } else if (corruption == MISSING_CELL) {
+            row.pop_back();
+            should_throw = c > 1 ? r > 1 : -1;
+        } else if (corruption == BAD_TOKEN) {
+            row[j] = "abc";
+            should_throw = 1;
+        } else {
+            row[j] = "";
+            should_throw = c > 1 ? 1 : -1;
+        }
         string path = save_csv(s, "tmp.csv");
 
         ASSERT_NO_DEATH(read_matrix_csv(path), ".*"); // should not crash, but throw error
-        if (r > 1) {
+        if (should_throw == 1) {
             ASSERT_ANY_THROW(read_matrix_csv(path)); // should throw some kind of error
-        } else {
+        } else if (should_throw == 0) {
             read_matrix_csv(path); // should not throw an error
         }
     }
@@ -992,20 +1247,187 @@ TEST_P(ReadTestsWhiteSpace, ReadRandomCSVWithSpaces) {
     string path = save_csv(s, "tmp.csv");
 }
 
+/*
+ * (num rows, num cols) for ReadTests.
+ */
+vector<std::tuple<int, int>> read_cases() {
+    static vector<std::tuple<int, int>> cases = CaseGenerator::generate<std::tuple<int, int>>(
+            "Question3", "ReadTests", Q3BUDGET_MS / 3,
+        [](CaseGenerator::Random& random) {
+            return std::make_tuple(draw_dimension(random, 1, 300), draw_dimension(random, 1, 300));
+        },
+        [](const std::tuple<int, int>& c) {
+            return 2 * FORK_MS + 2 * std::get<0>(c) * std::get<1>(c) * CSV_CELL_MS;
+        });
+    return cases;
+}
+
+/*
+ * (num rows, num cols, corruption) for ReadBrokenTests.
+ */
+vector<std::tuple<int, int, int>> read_broken_cases() {
+    static vector<std::tuple<int, int, int>> cases = CaseGenerator::generate<std::tuple<int, int, int>>(
+            "Question3", "ReadBrokenTests", Q3BUDGET_MS / 3,
+        [](CaseGenerator::Random& random) {
+            return std::make_tuple(draw_dimension(random, 1, 300),
+                                   draw_dimension(random, 1, 300),
+                                   random.uniform(0, NUM_CORRUPTIONS - 1));
+        },
+        [](const std::tuple<int, int, int>& c) {
+            return 2 * FORK_MS + 2 * std::get<0>(c) * std::get<1>(c) * CSV_CELL_MS;
+        });
+    return cases;
+}
+
+/*
+ * (num rows, num cols, white space character) for ReadTestsWhiteSpace.
+ */
+vector<std::tuple<int, int, char>> read_whitespace_cases() {
+    static vector<std::tuple<int, int, char>> cases = CaseGenerator::generate<std::tuple<int, int, char>>(
+            "Question3", "ReadTestsWhiteSpace", Q3BUDGET_MS / 3,
+        [](CaseGenerator::Random& random) {
+            return std::make_tuple(draw_dimension(random, 1, 300),
+                                   draw_dimension(random, 1, 300),
+                                   random.pick(vector<char>{' ', '\t'}));
+        },
+        [](const std::tuple<int, int, char>& c) {
+            return 0.1 + std::get<0>(c) * std::get<1>(c) * CSV_CELL_MS;
+        });
+    return cases;
+}
+
 INSTANTIATE_TEST_CASE_P(ReadTests,
         ReadTests,
-        ::testing::Combine(
-            testing::Values(1, 10, 100), // num rows
-            testing::Values(1, 10, 100)     // num cols
-        )
+        ::testing::ValuesIn(read_cases())
+);
+
+INSTANTIATE_TEST_CASE_P(ReadTests,
+        ReadBrokenTests,
+        ::testing::ValuesIn(read_broken_cases())
 );
 
 INSTANTIATE_TEST_CASE_P(ReadTestsWhiteSpace, ReadTestsWhiteSpace,
-        ::testing::Combine(
-                testing::Values(1, 10, 100), // num rows
-                testing::Values(1, 10, 100), // num cols
-                testing::Values(' ', '\t')  // white space character
-                ));
+        ::testing::ValuesIn(read_whitespace_cases())
+);
+
+/*
+ * Ways FuzzReadTests mutates csv text, besides flipping, deleting,
+ * inserting and splicing bytes. Each instance of the test fuzzes with one.
+ */
+enum CsvMutation {
+    WHITESPACE,         // spaces or tabs around a separator
+    MISSING_CELLS,      // a value cut out, leaving its commas
+    STRAY_CHARACTERS,   // a character that does not belong in a number
+    HUGE_NUMBERS,       // a value replaced by one out of the range of a double
+    CRLF,               // "\r\n" or a lone "\r" for a line ending
+    TRAILING_COMMAS,    // commas at the end of a line
+    NUM_CSV_MUTATIONS
+};
+
+/*!
+ * Position of a random separator (comma or newline) in "text", or of any
+ * character if there is none.
+ */
+size_t random_separator(const string& text, CaseGenerator::Random& random) {
+    vector<size_t> separators;
+    for (size_t i = 0; i < text.size(); i++) {
+        if (text[i] == ',' || text[i] == '\n') {
+            separators.push_back(i);
+        }
+    }
+    if (separators.empty()) {
+        return text.empty() ? 0 : random.uniform(0, text.size() - 1);
+    }
+    return random.pick(separators);
+}
+
+/*!
+ * A mutation of the given kind, for the Fuzzer.
+ */
+Fuzzer::Mutation csv_mutation(int kind) {
+    return [kind](string& text, CaseGenerator::Random& random) {
+        size_t at = random_separator(text, random);
+        size_t end = std::min(text.find_first_of(",\n", at + 1), text.size());
+        switch (kind) {
+            case WHITESPACE:
+                text.insert(std::min(at + random.uniform(0, 1), text.size()), random.uniform(1, 3),
+                            random.chance(0.5) ? ' ' : '\t');
+                break;
+            case MISSING_CELLS:
+                if (at < text.size()) {
+                    text.erase(at + 1, end - at - 1);
+                }
+                break;
+            case STRAY_CHARACTERS:
+                text.insert(text.begin() + random.uniform(0, text.size()),
+                            random.pick(vector<char>{'a', 'x', 'e', 'E', '-', '+', '.', '#', '"', ';', '\0', '\x7f'}));
+                break;
+            case HUGE_NUMBERS:
+                if (at < text.size()) {
+                    text.replace(at + 1, end - at - 1, random.pick(vector<string>{
+                            "1e308", "1e309", "-1e400", "1e-400", "nan", "inf", "-inf", "0x1p2000",
+                            "9223372036854775808", string(random.uniform(20, 400), '9')}));
+                }
+                break;
+            case CRLF:
+                if (random.chance(0.5)) {
+                    for (size_t i = text.find('\n'); i != string::npos; i = text.find('\n', i + 2)) {
+                        text.insert(i, "\r");
+                    }
+                } else {
+                    text.insert(at, "\r");
+                }
+                break;
+            default: {
+                size_t line = text.find('\n', at);
+                text.insert(line == string::npos ? text.size() : line, random.uniform(1, 3), ',');
+            }
+        }
+    };
+}
+
+/*
+ * Feeds mutated csv text to read_matrix_csv, with coverage feedback from
+ * the student's utilities.cc (see fuzz.h). Any crash, sanitizer error or
+ * hang fails the test, with the smallest input found that still causes it,
+ * and so does a session that did not run all its inputs.
+ * Throwing is fine: these inputs may or may not be valid.
+ */
+class FuzzReadTests : public Question3,
+                      public ::testing::WithParamInterface<int> {
+};
+
+TEST_P(FuzzReadTests, FuzzReadMatrixCSV) {
+    int kind = GetParam();
+    Fuzzer fuzzer;
+    fuzzer.seed = CaseGenerator::seed() ^ kind;
+    fuzzer.max_executions = (long) (Q3FUZZ_EXECUTIONS * CaseGenerator::budget_scale());
+    fuzzer.mutations.push_back(csv_mutation(kind));
+
+    CaseGenerator::Random random(fuzzer.seed);
+    for (int n = 0; n < 4; n++) {
+        int rows = random.uniform(1, 5),
+            cols = random.uniform(1, 5);
+        string text;
+        for (int i = 0; i < rows; i++) {
+            for (int j = 0; j < cols; j++) {
+                text += std::to_string(random.uniform(-1000000, 1000000) / 1000.0) + (j < cols - 1 ? "," : "\n");
+            }
+        }
+        fuzzer.seeds.push_back(text);
+    }
+
+    FuzzFinding finding = fuzzer.run([](const string& path) {
+        read_matrix_csv(path);
+    });
+    std::cerr << "[ FUZZ     ] " << fuzzer.summary() << std::endl;
+    EXPECT_EQ(finding.kind, FuzzFinding::NONE) << finding.describe();
+    EXPECT_FALSE(fuzzer.cut_short()) << "fuzzing did not finish: " << fuzzer.summary();
+}
+
+INSTANTIATE_TEST_CASE_P(FuzzReadTests, FuzzReadTests,
+        ::testing::Range(0, (int) NUM_CSV_MUTATIONS)
+);
 
 /*
  * Question 4 *************************************************
@@ -1036,12 +1458,24 @@ TEST_P(WriteTests, WriteRandomCSV) {
     write_matrix_csv(m, "tmp.csv");
     }
 
+/*
+ * (num rows, num cols) for WriteTests. Rows may be 0.
+ */
+vector<std::tuple<int, int>> write_cases() {
+    static vector<std::tuple<int, int>> cases = CaseGenerator::generate<std::tuple<int, int>>(
+            "Question4", "WriteTests", Q4BUDGET_MS,
+        [](CaseGenerator::Random& random) {
+            return std::make_tuple(draw_dimension(random, 0, 300), draw_dimension(random, 1, 300));
+        },
+        [](const std::tuple<int, int>& c) {
+            return 2 * FORK_MS + 2 * std::get<0>(c) * std::get<1>(c) * CSV_CELL_MS;
+        });
+    return cases;
+}
+
 INSTANTIATE_TEST_CASE_P(WriteTests,
         WriteTests,
-        ::testing::Combine(
-        testing::Values(0, 1, 10, 100),
-        testing::Values(1, 10, 100)
-)
+        ::testing::ValuesIn(write_cases())
 );
 
 /*
@@ -1062,34 +1496,11 @@ INSTANTIATE_TEST_CASE_P(WriteTests,
  * so "done" results in keys i'm, so, and done. Consider the following examples:
  */
 
-#define MAPDELIM " %%:%% "
-
 class BaseMapTest : public Question5 {
 public:
 
     static std::map<string, int> load_mapping(const string &path) {
-        std::cout << "loading " << path << std::endl;
-
-        std::ifstream infile;
-        infile.open(path, std::ifstream::in);
-        string line, token;
-        vector <string> temp_tokens;
-        temp_tokens.resize(2);
-
-        std::map<string, int> m;
-        while (std::getline(infile, line)) {
-            int n = line.find(MAPDELIM);
-            if (n != std::string::npos) {
-                string key = line.substr(0, n);
-                string delim = MAPDELIM;
-                int num = std::stoi(line.substr(n + delim.size()));
-                m[key] = num;
-            }
-        }
-        infile.close();
-        std::cout << m.size() << "!\n";
-
-        return m;
+        return AnswerKeys::load(path);
     }
 
 };
@@ -1136,6 +1547,43 @@ TEST_P(MapKeywordTests, CheckNumInstanceCorrect) {
     ASSERT_EQ(map[key], n);
 }
 
+class MapComplexityTests : public Question5 {
+};
+
+/*
+ * occurrence_map should take about n log n in the number of words,
+ * e.g. one map insertion per word. The text repeats the keywords of the
+ * answer map, so the number of distinct words stays the same.
+ */
+TEST_F(MapComplexityTests, OccurrenceMapGrowth) {
+    string path = "complexity_words.txt";
+    vector<string> words;
+    for (auto& entry : expected_map_) {
+        words.push_back(entry.first);
+    }
+    ASSERT_FALSE(words.empty()) << "Could not load " << expected_path_;
+
+    Complexity complexity;
+    complexity.max_n = 1 << 17;
+    int written = 0;
+    ComplexityFit fit = complexity.measure(
+        [&](int n) {
+            if (n != written) { // only rewrite the file when the size changes
+                std::ofstream out(path);
+                for (int i = 0; i < n; i++) {
+                    out << words[i % words.size()] << ((i + 1) % 12 ? " " : ".\n");
+                }
+                written = n;
+            }
+            return path;
+        },
+        [](const string& p) {
+            std::map<string, int> map = occurrence_map(p);
+        });
+    remove(path.c_str());
+    EXPECT_COMPLEXITY_AT_MOST(fit, N_LOG_N);
+}
+
 INSTANTIATE_TEST_CASE_P(MapKeywordTests, MapKeywordTests,
         ::testing::ValuesIn(expected_map_) // size of the first array
 );
\ No newline at end of file
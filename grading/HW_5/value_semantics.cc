@@ -0,0 +1,131 @@
+// The operations of value_semantics.h on TypedMatrix<Counted>.
+//
+// MakefileGrade compiles this file on its own (OPTIONAL). If the student's
+// TypedMatrix does not compile with Counted elements, it is compiled again
+// with GRADE_FALLBACK, which leaves out every use of TypedMatrix<Counted>.
+
+#include <stdlib.h>
+#include <fstream>
+#include "value_semantics.h"
+
+#ifndef GRADE_FALLBACK
+
+#include "typed_matrix.h"
+#include "counted.h"
+
+/*!
+ * Random TypedMatrix<Counted> of size rxc, using the student's r vs c convention
+ */
+static TypedMatrix<Counted> counted_typed_matrix(int r, int c, int convention) {
+    TypedMatrix<Counted> m = convention == 1 ? TypedMatrix<Counted>(r, c) : TypedMatrix<Counted>(c, r);
+    for (int i = 0; i < r; i++) {
+        for (int j = 0; j < c; j++) {
+            m.set(i, j, Counted(-100 + rand() / (RAND_MAX / 200.0)));
+        }
+    }
+    return m;
+}
+
+/*!
+ * Returns its argument. The parameter cannot be elided, so it is
+ * moved into the return value if TypedMatrix has a move constructor.
+ */
+static TypedMatrix<Counted> pass_through(TypedMatrix<Counted> m) {
+    return m;
+}
+
+bool ValueSemantics::available() {
+    return true;
+}
+
+std::string ValueSemantics::problem() {
+    return "";
+}
+
+long ValueSemantics::move_construct(int r, int c, int convention) {
+    TypedMatrix<Counted> a = counted_typed_matrix(r, c, convention);
+    Counted::reset();
+    TypedMatrix<Counted> b(std::move(a));
+    return Counted::counts().copies();
+}
+
+long ValueSemantics::move_assign(int r, int c, int convention) {
+    TypedMatrix<Counted> a = counted_typed_matrix(r, c, convention);
+    TypedMatrix<Counted> b = counted_typed_matrix(r, c, convention);
+    Counted::reset();
+    b = std::move(a);
+    return Counted::counts().copies();
+}
+
+long ValueSemantics::copy_assign(int r, int c, int convention) {
+    TypedMatrix<Counted> a = counted_typed_matrix(r, c, convention);
+    TypedMatrix<Counted> b;
+    Counted::reset();
+    b = a;
+    return Counted::counts().copies();
+}
+
+long ValueSemantics::return_by_value(int r, int c, int convention) {
+    TypedMatrix<Counted> a = counted_typed_matrix(r, c, convention);
+    Counted::reset();
+    TypedMatrix<Counted> b = pass_through(std::move(a));
+    return Counted::counts().copies();
+}
+
+void ValueSemantics::add_temporary(int r, int c, int convention, long* add_copies, long* assign_copies) {
+    TypedMatrix<Counted> m1 = counted_typed_matrix(r, c, convention);
+    TypedMatrix<Counted> m2 = counted_typed_matrix(r, c, convention);
+    TypedMatrix<Counted> m3 = counted_typed_matrix(r, c, convention);
+
+    // copies made computing the sum, which binds to the reference without a copy
+    Counted::reset();
+    {
+        const TypedMatrix<Counted>& sum = m1 + m2;
+        (void) sum;
+    }
+    *add_copies = Counted::counts().copies();
+
+    // copies made handing the temporary sum over to m3
+    Counted::reset();
+    m3 = m1 + m2;
+    *assign_copies = Counted::counts().copies() - *add_copies;
+}
+
+#else
+
+bool ValueSemantics::available() {
+    return false;
+}
+
+std::string ValueSemantics::problem() {
+    std::ifstream errors(VALUESEMANTICSERRORS);
+    std::string line;
+    while (std::getline(errors, line)) {
+        if (line.find("error:") != std::string::npos) {
+            return "TypedMatrix<Counted> does not compile: " + line;
+        }
+    }
+    return "TypedMatrix<Counted> does not compile, see " VALUESEMANTICSERRORS;
+}
+
+long ValueSemantics::move_construct(int, int, int) {
+    return -1;
+}
+
+long ValueSemantics::move_assign(int, int, int) {
+    return -1;
+}
+
+long ValueSemantics::copy_assign(int, int, int) {
+    return -1;
+}
+
+long ValueSemantics::return_by_value(int, int, int) {
+    return -1;
+}
+
+void ValueSemantics::add_temporary(int, int, int, long* add_copies, long* assign_copies) {
+    *add_copies = *assign_copies = -1;
+}
+
+#endif
@@ -0,0 +1,41 @@
+// Element copies of TypedMatrix<Counted>, built apart from the other tests.
+
+#ifndef ECE590_VALUE_SEMANTICS_H
+#define ECE590_VALUE_SEMANTICS_H
+
+#include <string>
+
+#define VALUESEMANTICSERRORS "build/value_semantics.errors" // compiler errors kept by MakefileGrade
+
+/*
+ * The operations ValueSemanticsTests grades, each on random TypedMatrix<Counted>
+ * of r x c (c x r if the student's "convention" is -1), returning the element
+ * copies the operation itself made.
+ *
+ * Only value_semantics.cc instantiates TypedMatrix with a non-arithmetic
+ * element type, which a student's matrix may not compile with. MakefileGrade
+ * (OPTIONAL) then builds it again with GRADE_FALLBACK, and available() is
+ * false: the ValueSemanticsTests fail, and the rest of the suite still runs.
+ */
+class ValueSemantics {
+public:
+
+    static bool available();
+
+    /*!
+     * Why available() is false, e.g. the first error of VALUESEMANTICSERRORS.
+     */
+    static std::string problem();
+
+    static long move_construct(int r, int c, int convention);       // TypedMatrix b(std::move(a))
+    static long move_assign(int r, int c, int convention);          // b = std::move(a)
+    static long copy_assign(int r, int c, int convention);          // b = a, b empty
+    static long return_by_value(int r, int c, int convention);      // b = pass_through(std::move(a))
+
+    /*!
+     * m3 = m1 + m2: the copies computing the sum, and those handing it to m3.
+     */
+    static void add_temporary(int r, int c, int convention, long* add_copies, long* assign_copies);
+};
+
+#endif //ECE590_VALUE_SEMANTICS_H
@@ -6,20 +6,33 @@ STUDENTREPO="AutomatedGTestGradingExample"        # the name of the student's re
 DIR=$PWD                    # current working directory
 RESULTS="$DIR/results"      # output directory for results
 DUEDATE=""           # the due date of the homework
+REMOTE="https://github.com" # where student and class repos are cloned from
+HWDIR=""                    # if set, the only directory checked out of each student repo
+JOBS=4                      # number of repos synced at once
+STARTERREPO=""              # if set, repo the students' repos were created from, e.g. 'klavins/AutomatedGTestGradingExample'
+MIRROR="$DIR/$STUDENTDIR/.mirror.git" # bare mirror of STARTERREPO that every clone borrows objects from
+FILTER="blob:none"          # partial clone filter: file contents are only fetched once read
 
 MAKE="MakefileGrade$TESTVER"        # name of the makefile to use for compiling
 
 SUMMARY="$RESULTS/summary.csv"
+TIMING="$RESULTS/timing.csv" # seconds spent pulling each student, as "login,pull,seconds"
+PULLLOGS="$RESULTS/pull"     # git's output for each repo, as "<login>.log"
+SYNCS="$RESULTS/pull.csv"    # each repo of the last run, as "login,action,status,seconds"
 GRADEPATTERN="HOMEWORK_GRADE:" # pattern to look for from main.c to build the summary
 
 ###### OPTIONS ######
-while getopts i:l:d: option
+while getopts i:l:d:r:h:j:m: option
 do
 case "${option}"
 in
 i) input=${OPTARG};;  # the input file for student logins
 l) login=${OPTARG};;  # optionally provide a single login to evalute just one student
 d) DUEDATE=${OPTARG};; # due date for the homework
+r) REMOTE=${OPTARG};;  # base url of the repos, e.g. file:///path/to/repos
+h) HWDIR=${OPTARG};;   # homework directory to check out
+j) JOBS=${OPTARG};;    # number of repos synced at once
+m) STARTERREPO=${OPTARG};; # starter repo to mirror
 esac
 done
 shift $((OPTIND -1))
@@ -28,69 +41,128 @@ function usage() {
     echo "Usage:"
     echo "-l   Student's github login (optional)"
     echo "-i   Filepath of csv of all students [LAST_NAME,FIRST_NAME,GITHUB_LOGIN]"
-    echo "-d   The due date for the assignment e.g. '2019-01-21'"
+    echo "-d   The due date for the assignment e.g. '2019-01-21', or a comma separated list of them"
+    echo "-r   Base url to clone repos from (default 'https://github.com')"
+    echo "-h   Only check out this homework directory of each student repo, e.g. 'HW_5'"
+    echo "-j   Sync this many repos at once (default 4)"
+    echo "-m   Starter repo the students' repos were created from, e.g. 'klavins/AutomatedGTestGradingExample'."
+    echo "     Its objects are kept once, in $STUDENTDIR/.mirror.git, and shared by every clone"
 }
 
 ###### FUNCTIONS ######
+
+# Clones repo $2 into directory $1, or fetches it if it was cloned before,
+# and sets ACTION to what it did. Only the files under directory $3 are
+# checked out if it is given. Clones are partial ($FILTER) and borrow the
+# objects of $MIRROR when there is one.
 function pull_repo () {
     directory=$1
     repo=$2
-    echo ""
-    echo "Pulling repo '$1'"
+    echo "Pulling repo '$repo'"
 
-    if [[ -e $1 ]];
+    if [[ -e $directory ]];
     then
-        echo "INFO: '$directory' already exists. Attempting to fetch and prune..."
-        PREVDIR=$PWD
-        cd $1
-        git fetch origin --prune #> git.log 2>&1
-        success=$?
-        if [[ $success -eq 0 ]];
+        ACTION="fetched"
+        if [[ -d $MIRROR ]] && ! grep -qsx "$MIRROR/objects" $directory/.git/objects/info/alternates;
         then
-            echo "INFO: Successfully fetched and pruned the repo"
-        else
-            echo "ERROR: There was an error trying to fetch the repo"
+            echo "$MIRROR/objects" >> $directory/.git/objects/info/alternates
         fi
-        cd $PREVDIR
+        # grade.sh reads master, so it is fast-forwarded as in graded.sh
+        git -C $directory fetch --prune --update-head-ok origin \
+            +master:master '+refs/heads/*:refs/remotes/origin/*'
     else
-        echo "INFO: '$directory' does not exist. Attempting clone repo..."
-        git clone "https://github.com/$repo" $directory # > git.log 2>&1
-        success=$?
-        if [[ $success -eq 0 ]];
+        ACTION="cloned"
+        git clone ${FILTER:+--filter=$FILTER} ${3:+--sparse} \
+            $([[ -d $MIRROR ]] && echo "--reference-if-able $MIRROR") "$REMOTE/$repo" $directory || return 1
+        if [[ $3 ]];
         then
-            echo "INFO: Repo '$repo' successfully cloned"
-        else
-            echo "ERROR: Failed to pull repo '$repo'"
+            git -C $directory sparse-checkout set $3
         fi
     fi
 }
 
+# Fetches, in one request, the blobs under directory $2 (the whole tree if
+# empty) of repo $1 that a partial clone is missing, for each commit grade.sh
+# reads: the latest on master, and the last before each date in $DUEDATE.
+# Otherwise grade.sh fetches them over the network, one round trip each.
+function prefetch_blobs() {
+    directory=$1
+    commits="$(git -C $directory rev-parse --verify -q master)"
+    IFS=',' read -ra deadlines <<< "$DUEDATE"
+    for due in "${deadlines[@]}"
+    do
+        commits="$commits $(git -C $directory rev-list master -n 1 --first-parent --before=$due --date=local)"
+    done
+    # The trees themselves, since a path limit would skip the commits that
+    # do not change $2.
+    trees=""
+    for commit in $commits
+    do
+        trees="$trees $(git -C $directory rev-parse --verify -q "$commit:$2")"
+    done
+    missing="$(git -C $directory rev-list --objects --missing=print --no-walk $trees | sed -n 's/^?//p')"
+    if [[ $missing ]];
+    then
+        echo "Prefetching $(echo "$missing" | wc -l) blobs"
+        echo "$missing" | git -C $directory fetch --no-tags --no-write-fetch-head --filter=$FILTER --stdin origin
+    fi
+}
+
+# Creates or refreshes the bare mirror of $STARTERREPO. It is never garbage
+# collected, since every student clone may use its objects.
+function update_mirror() {
+    if [[ -d $MIRROR ]];
+    then
+        git -C $MIRROR fetch --prune origin
+    else
+        git clone --mirror "$REMOTE/$STARTERREPO" $MIRROR && git -C $MIRROR config gc.auto 0
+    fi
+}
+
 function no_white_space() {
     NO_WHITESPACE="$(echo "${1}" | tr -d '[:space:]')"
     echo $NO_WHITESPACE
 }
 
-function evaluate() {
-  echo "\nEvaluating $1 $2 ($3)"
-  lname=$(no_white_space $1)
-  fname=$(no_white_space $2)
-  login=$(no_white_space $3)
-
-  cd $DIR
-  OUTDIR="${RESULTS}/${HWDIR}"
-  mkdir -p $OUTDIR
-  OUT="${OUTDIR}/${login}.out"
-  echo "Student : ${fname} ${lname} (${login})"
-  echo "Github  : ${login}"
-  echo "\nPULL:"
-
-  pull_repo $STUDENTDIR/$login $login/$STUDENTREPO
+function seconds_since() {
+    awk -v start=$1 -v end=$(date +%s.%N) 'BEGIN {printf "%.3f", end - start}'
+}
+
+# Syncs the repo of student $1, logging git's output to $PULLLOGS/$1.log,
+# and prints one line with the result. Runs as one of $JOBS background jobs,
+# so every file is only appended to with single short lines.
+function sync_student() {
+  login=$1
+  log=$PULLLOGS/$login.log
+  start=$(date +%s.%N)
+  ACTION="cloned"
+  pull_repo $STUDENTDIR/$login $login/$STUDENTREPO $HWDIR > $log 2>&1 &&
+    prefetch_blobs $STUDENTDIR/$login $HWDIR >> $log 2>&1
+  success=$?
+  seconds=$(seconds_since $start)
+  echo "$login,pull,$seconds" >> $TIMING
+  if [[ $success -eq 0 ]];
+  then
+    echo "$login,$ACTION,ok,$seconds" >> $SYNCS
+    printf "%-24s %-8s %8ss\n" $login $ACTION $seconds
+  else
+    echo "$login,$ACTION,failed,$seconds" >> $SYNCS
+    printf "%-24s %-8s %8ss FAILED: %s\n" $login $ACTION $seconds "$(grep -m 1 -E '^(fatal|error):' $log || tail -n 1 $log)"
+  fi
 }
 
 ###### SETUP ######
 echo "***** SETUP *****"
-mkdir -p $RESULTS
+mkdir -p $RESULTS $PULLLOGS $STUDENTDIR
+: > $SYNCS
+# a job waiting for credentials would hang the run
+export GIT_TERMINAL_PROMPT=0
 pull_repo $CLASSREPO "klavins/ECEP520"
+if [[ $STARTERREPO ]];
+then
+    echo "Mirroring '$STARTERREPO' in $MIRROR"
+    update_mirror || echo "ERROR: Failed to mirror '$STARTERREPO', cloning without it"
+fi
 echo "***** END SETUP *****"
 echo ""
 
@@ -103,17 +175,41 @@ then
     [[ -e $RESULTS ]] && rm -rf $RESULTS
     touch $SUMMARY
 fi
+started=$(date +%s.%N)
 if [[ $input ]];
 then
-    echo "Reading '${input}'"
+    echo "Reading '${input}', $JOBS repos at once"
+    running=0
+    workers=()
     while IFS=',' read fname lname login
     do
-      echo "Login $login"
-      evaluate $lname $fname $login
+      login=$(no_white_space $login)
+      [[ $login ]] || continue
+      if [[ $running -ge $JOBS ]];
+      then
+        wait -n
+        running=$((running - 1))
+      fi
+      sync_student $login &
+      workers+=($!)
+      running=$((running + 1))
     done < "$input"
+    if [[ ${#workers[@]} -gt 0 ]];
+    then
+      wait "${workers[@]}"
+    fi
 else
     echo "Using single login '$login'"
-    evaluate "unknown" "unknown" $login
+    sync_student $login
 fi
 
+failed=$(grep -c ',failed,' $SYNCS)
+awk -F',' -v seconds=$(seconds_since $started) '
+  { n++; count[$2]++ }
+  END { printf "PULLED: %d repos in %.1fs (%d cloned, %d fetched)\n", n, seconds, count["cloned"], count["fetched"] }' $SYNCS
+if [[ $failed -gt 0 ]];
+then
+    echo "FAILED: $failed repos, see $PULLLOGS/<login>.log: $(grep ',failed,' $SYNCS | cut -d',' -f1 | tr '\n' ' ')"
+fi
 echo "***** END PULL *****"
+[[ $failed -eq 0 ]]
@@ -0,0 +1,334 @@
+//
+// Shows a grading run live: throughput, an ETA and how often each
+// question fails, from the events the test programs of every student
+// publish. See "gradewatch -h" and README.md.
+//
+// Test programs run with --grade_events=SOCKET,LABEL connect to SOCKET and
+// send one packet per test (grading/HW_5/grade_events.h). Each program has
+// its own connection, so a program that closes it in the middle of a test
+// crashed there, or was killed.
+//
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#define GRADEEVENTMAGIC 0x45475645 // first field of every event
+#define RATEWINDOW 10.0            // seconds of completed tests the throughput is taken over
+
+/*
+ * One event, as sent by GradeEvents in grading/HW_5/grade_events.h.
+ */
+struct GradeEvent {
+    enum Type : uint8_t { PROGRAM_START = 1, QUESTION = 2, TEST_START = 3, TEST_END = 4, PROGRAM_END = 5 };
+
+    uint32_t magic;
+    uint8_t type;
+    uint8_t passed;
+    int16_t question;
+    uint32_t count;
+    uint32_t duration_ms;
+    char label[32];
+    char name[64];
+};
+
+/*
+ * Gradewatch settings, from the command line.
+ */
+struct Options {
+    std::string socket;                 // where test programs connect
+    long students = 0;                  // students in the run, for the ETA
+    long interval_ms = 1000;            // time between status lines
+};
+
+/*
+ * One connected test program.
+ */
+struct Program {
+    std::string label;
+    std::string running;                // test started and not ended, or ""
+    bool ended = false;                 // PROGRAM_END seen
+};
+
+struct QuestionStats {
+    std::string name;
+    long tests = 0;
+    long failed = 0;
+};
+
+struct Student {
+    long announced = 0;                 // tests its programs said they would run
+    long done = 0;
+};
+
+static volatile sig_atomic_t stopping = 0;
+
+static std::map<int, Program> programs; // by connection
+static std::map<int, QuestionStats> questions;
+static std::map<std::string, int> case_questions; // test case name to question, learned from TEST_END
+static std::map<std::string, Student> students;
+static std::vector<std::string> crashes;
+static std::deque<double> finished;    // when each recent test ended
+static long tests_done = 0;
+static struct timespec started;
+
+static void stop(int) {
+    stopping = 1;
+}
+
+static void die(const std::string& what) {
+    fprintf(stderr, "gradewatch: %s: %s\n", what.c_str(), strerror(errno));
+    exit(1);
+}
+
+static double seconds_since(const struct timespec& start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+static std::string field(const char* text, size_t size) {
+    return std::string(text, strnlen(text, size));
+}
+
+static void test_done(const std::string& label, const std::string& test, int question, bool passed) {
+    std::string test_case = test.substr(0, test.find('.'));
+    if (question >= 0) {
+        case_questions[test_case] = question;
+    } else if (case_questions.count(test_case)) {
+        question = case_questions[test_case];
+    }
+    if (question >= 0) {
+        questions[question].tests++;
+        questions[question].failed += !passed;
+    }
+    students[label].done++;
+    tests_done++;
+    finished.push_back(seconds_since(started));
+}
+
+static void handle(Program& program, const GradeEvent& event) {
+    std::string name = field(event.name, sizeof(event.name));
+    switch (event.type) {
+        case GradeEvent::PROGRAM_START:
+            program.label = field(event.label, sizeof(event.label));
+            students[program.label].announced += event.count;
+            break;
+        case GradeEvent::QUESTION:
+            questions[event.question].name = name;
+            break;
+        case GradeEvent::TEST_START:
+            program.running = name;
+            break;
+        case GradeEvent::TEST_END:
+            program.running = "";
+            test_done(program.label, name, event.question, event.passed);
+            break;
+        case GradeEvent::PROGRAM_END:
+            program.ended = true;
+            break;
+    }
+}
+
+/*!
+ * A program closed its connection: it crashed or was killed unless it
+ * said it ended.
+ */
+static void disconnected(const Program& program) {
+    if (!program.running.empty()) {
+        crashes.push_back(program.label + " " + program.running);
+        test_done(program.label, program.running, -1, false);
+    } else if (!program.ended) {
+        crashes.push_back(program.label + " between tests");
+    }
+}
+
+static std::string duration(double seconds) {
+    char text[32];
+    long s = (long) seconds;
+    if (s >= 3600) {
+        snprintf(text, sizeof(text), "%ldh%02ldm", s / 3600, s / 60 % 60);
+    } else if (s >= 60) {
+        snprintf(text, sizeof(text), "%ldm%02lds", s / 60, s % 60);
+    } else {
+        snprintf(text, sizeof(text), "%lds", s);
+    }
+    return text;
+}
+
+/*!
+ * Tests completed per second over the last RATEWINDOW seconds.
+ */
+static double throughput() {
+    double now = seconds_since(started);
+    while (!finished.empty() && finished.front() < now - RATEWINDOW) {
+        finished.pop_front();
+    }
+    return finished.size() / std::min(RATEWINDOW, std::max(now, 1.0));
+}
+
+/*!
+ * Seconds left: every student is expected to run as many tests as the
+ * most any one has announced so far.
+ */
+static std::string eta(const Options& options, double rate) {
+    long per_student = 0;
+    for (auto& s : students) {
+        per_student = std::max(per_student, s.second.announced);
+    }
+    long total = std::max(options.students, (long) students.size()) * per_student;
+    if (rate <= 0 || per_student == 0) {
+        return "unknown";
+    }
+    return duration(std::max(0L, total - tests_done) / rate);
+}
+
+static void status(const Options& options, bool final) {
+    double rate = throughput();
+    int running = 0;
+    for (auto& p : programs) {
+        running += !p.second.ended;
+    }
+    char line[256];
+    if (final) {
+        double seconds = seconds_since(started);
+        snprintf(line, sizeof(line), "[ GRADEWATCH ] %zu students, %ld tests in %.0f s (%.0f/s), %zu crashes",
+                 students.size(), tests_done, seconds, tests_done / std::max(seconds, 1.0), crashes.size());
+    } else {
+        snprintf(line, sizeof(line), "[ GRADEWATCH ] %zu students, %d running, %ld tests at %.0f/s, ETA %s, %zu crashes |",
+                 students.size(), running, tests_done, rate, eta(options, rate).c_str(), crashes.size());
+    }
+    std::string text = line;
+    for (auto& q : questions) {
+        char rate_text[96];
+        double failed = q.second.tests ? 100.0 * q.second.failed / q.second.tests : 0;
+        if (final) {
+            snprintf(rate_text, sizeof(rate_text), "\n%s: %ld tests, %.1f%% failed", q.second.name.c_str(),
+                     q.second.tests, failed);
+        } else {
+            snprintf(rate_text, sizeof(rate_text), " %s %.1f%%", q.second.name.c_str(), failed);
+        }
+        text += rate_text;
+    }
+    if (final) {
+        for (const std::string& crash : crashes) {
+            text += "\ncrashed: " + crash;
+        }
+    }
+    bool terminal = isatty(STDOUT_FILENO);
+    printf(terminal && !final ? "\r\033[K%s" : "%s\n", text.c_str());
+    fflush(stdout);
+}
+
+static void usage() {
+    printf("Usage: gradewatch -s SOCKET [options]\n");
+    printf("Shows the progress of the test programs run with --grade_events=SOCKET,LABEL until SIGINT or SIGTERM\n");
+    printf("-s SOCKET  Unix socket to listen on; removed on exit\n");
+    printf("-n N       Number of students in the run, for the ETA\n");
+    printf("-i MS      Milliseconds between status lines (default 1000)\n");
+}
+
+static Options parse(int argc, char** argv) {
+    Options options;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:n:i:h")) != -1) {
+        switch (opt) {
+            case 's': options.socket = optarg; break;
+            case 'n': options.students = atol(optarg); break;
+            case 'i': options.interval_ms = atol(optarg); break;
+            default: usage(); exit(opt == 'h' ? 0 : 1);
+        }
+    }
+    if (options.socket.empty() || options.interval_ms < 1) {
+        usage();
+        exit(1);
+    }
+    return options;
+}
+
+int main(int argc, char** argv) {
+    Options options = parse(argc, argv);
+
+    sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (options.socket.size() >= sizeof(address.sun_path)) {
+        errno = ENAMETOOLONG;
+        die("socket " + options.socket);
+    }
+    strcpy(address.sun_path, options.socket.c_str());
+    unlink(options.socket.c_str());
+    int server = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (server < 0 || bind(server, (sockaddr*) &address, sizeof(address)) < 0 || listen(server, 128) < 0) {
+        die("listen on " + options.socket);
+    }
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stop; // without SA_RESTART, so poll returns
+    sigaction(SIGTERM, &action, NULL);
+    sigaction(SIGINT, &action, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    double next_status = options.interval_ms / 1000.0;
+
+    while (!stopping) {
+        std::vector<pollfd> fds = {{server, POLLIN, 0}};
+        for (auto& p : programs) {
+            fds.push_back({p.first, POLLIN, 0});
+        }
+        int timeout = std::max(0, (int) ((next_status - seconds_since(started)) * 1000));
+        if (poll(fds.data(), fds.size(), timeout) < 0 && errno != EINTR) {
+            die("poll");
+        }
+        if (fds[0].revents & POLLIN) {
+            int connection;
+            while ((connection = accept4(server, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK)) >= 0) {
+                programs[connection] = Program();
+            }
+        }
+        for (size_t i = 1; i < fds.size(); i++) {
+            if (fds[i].revents == 0) {
+                continue;
+            }
+            Program& program = programs[fds[i].fd];
+            GradeEvent event;
+            ssize_t n;
+            while ((n = recv(fds[i].fd, &event, sizeof(event), 0)) == sizeof(event)) {
+                if (event.magic == GRADEEVENTMAGIC) {
+                    handle(program, event);
+                }
+            }
+            if (n == 0 || (n < 0 && errno != EAGAIN)) {
+                disconnected(program);
+                close(fds[i].fd);
+                programs.erase(fds[i].fd);
+            }
+        }
+        if (seconds_since(started) >= next_status) {
+            status(options, false);
+            next_status += options.interval_ms / 1000.0;
+        }
+    }
+
+    unlink(options.socket.c_str());
+    if (isatty(STDOUT_FILENO)) {
+        printf("\n");
+    }
+    status(options, true);
+    return 0;
+}
@@ -0,0 +1,142 @@
+//
+// Holds the job tokens shared by every student build and test run of a
+// grading run, and reports how many of them were in use. See
+// "jobserver -h" and README.md.
+//
+// The tokens are bytes in a named pipe, as in GNU make's jobserver: a
+// process takes one before it starts a job and writes it back when the job
+// ends. make itself joins in when it is given the pipe with
+// "--jobserver-auth=R,W" in MAKEFLAGS. The number of tokens waiting in the
+// pipe is sampled, so the jobs holding the others need not report anything.
+//
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <string>
+
+/*
+ * Jobserver settings, from the command line.
+ */
+struct Options {
+    long tokens = 0;
+    std::string fifo;                   // the named pipe to create
+    long interval_ms = 100;             // time between samples
+    std::string samples;                // if set, "seconds,busy" is appended here for each sample
+};
+
+static volatile sig_atomic_t stopping = 0;
+
+static void stop(int) {
+    stopping = 1;
+}
+
+static void die(const std::string& what) {
+    fprintf(stderr, "jobserver: %s: %s\n", what.c_str(), strerror(errno));
+    exit(1);
+}
+
+static double seconds_since(const struct timespec& start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9;
+}
+
+static void usage() {
+    printf("Usage: jobserver -j N -f FIFO [options]\n");
+    printf("Creates FIFO holding N tokens and reports how many were in use on SIGTERM or SIGINT\n");
+    printf("-j N       Number of tokens, e.g. the number of cores\n");
+    printf("-f FIFO    Path of the named pipe to create; removed on exit\n");
+    printf("-i MS      Milliseconds between samples (default 100)\n");
+    printf("-o FILE    Append \"seconds,busy\" to FILE for every sample\n");
+}
+
+static Options parse(int argc, char** argv) {
+    Options options;
+    int opt;
+    while ((opt = getopt(argc, argv, "j:f:i:o:h")) != -1) {
+        switch (opt) {
+            case 'j': options.tokens = atol(optarg); break;
+            case 'f': options.fifo = optarg; break;
+            case 'i': options.interval_ms = atol(optarg); break;
+            case 'o': options.samples = optarg; break;
+            default: usage(); exit(opt == 'h' ? 0 : 1);
+        }
+    }
+    if (options.tokens < 1 || options.fifo.empty() || options.interval_ms < 1) {
+        usage();
+        exit(1);
+    }
+    return options;
+}
+
+int main(int argc, char** argv) {
+    Options options = parse(argc, argv);
+
+    FILE* samples = NULL;
+    if (!options.samples.empty() && (samples = fopen(options.samples.c_str(), "a")) == NULL) {
+        die("open " + options.samples);
+    }
+
+    if (mkfifo(options.fifo.c_str(), 0600) < 0) {
+        die("mkfifo " + options.fifo);
+    }
+    // opened for writing too, so the pipe never reports end of file and
+    // the tokens stay buffered while nobody else has it open
+    int fifo = open(options.fifo.c_str(), O_RDWR | O_CLOEXEC);
+    if (fifo < 0) {
+        die("open " + options.fifo);
+    }
+    std::string tokens(options.tokens, '+');
+    if (write(fifo, tokens.c_str(), tokens.size()) != (ssize_t) tokens.size()) {
+        unlink(options.fifo.c_str());
+        die("write tokens");
+    }
+
+    signal(SIGTERM, stop);
+    signal(SIGINT, stop);
+    struct timespec started;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    struct timespec interval = {options.interval_ms / 1000, (options.interval_ms % 1000) * 1000000};
+
+    long count = 0;
+    double busy_total = 0;
+    long peak = 0;
+    long saturated = 0;
+    while (!stopping) {
+        int waiting = 0;
+        if (ioctl(fifo, FIONREAD, &waiting) < 0) {
+            die("FIONREAD");
+        }
+        long busy = options.tokens - waiting;
+        count++;
+        busy_total += busy;
+        peak = busy > peak ? busy : peak;
+        saturated += busy >= options.tokens;
+        if (samples != NULL) {
+            fprintf(samples, "%.1f,%ld\n", seconds_since(started), busy);
+        }
+        nanosleep(&interval, NULL);
+    }
+
+    if (samples != NULL) {
+        fclose(samples);
+    }
+    unlink(options.fifo.c_str());
+    close(fifo);
+    if (count > 0) {
+        printf("[ JOBSERVER ] %ld tokens for %.0f s: %.0f%% utilization, %.1f busy on average, "
+               "peak %ld, all busy %.0f%% of the time\n",
+               options.tokens, seconds_since(started), 100.0 * busy_total / count / options.tokens,
+               busy_total / count, peak, 100.0 * saturated / count);
+    }
+    return 0;
+}
@@ -0,0 +1,72 @@
+#!/bin/bash
+
+# Compiler launcher that caches object files by content, so a translation
+# unit that is the same for many students, homeworks or runs is compiled
+# once. Used by MakefileGrade as
+#
+#   make -f MakefileGrade CCACHE=tools/objcache.sh
+#
+# The key is the hash of the compiler's version, its flags and the
+# preprocessed source. Objects are built with the working directory mapped
+# to ".", so the same source compiles to the same object in any student's
+# directory. Anything but a single "-c" compile runs the compiler unchanged.
+
+OBJCACHE_DIR=${OBJCACHE_DIR:-$HOME/.cache/objcache} # where the objects are kept
+OBJCACHE_LOG=${OBJCACHE_LOG:-$OBJCACHE_DIR/stats}   # "hit" or "miss" is appended here for each compile
+mkdir -p $OBJCACHE_DIR
+
+compile=""
+output=""
+flags=()
+args=("$@")
+for ((i = 1; i < ${#args[@]}; i++))
+do
+  case "${args[$i]}" in
+  -c) compile=1;;
+  -o) i=$((i + 1)); output=${args[$i]};;
+  *) flags+=("${args[$i]}");;
+  esac
+done
+if ! [[ $compile ]] || ! [[ $output ]];
+then
+  exec "$@"
+fi
+
+compiler=$1
+key="$(
+  set -o pipefail
+  {
+    $compiler --version
+    echo "${flags[@]}"
+    $compiler "${flags[@]}" -E -fno-working-directory 2>/dev/null
+  } | sha256sum | cut -d' ' -f1
+)"
+if [[ $? -ne 0 ]];
+then
+  # e.g. a missing header: let the compiler report it
+  exec "$@"
+fi
+entry="$OBJCACHE_DIR/${key:0:2}/$key"
+
+if [[ -e $entry.o ]] && cp $entry.o $output;
+then
+  cat $entry.stderr >&2 2>/dev/null
+  echo "hit $key" >> $OBJCACHE_LOG
+  exit 0
+fi
+
+$compiler "${flags[@]}" -fdebug-prefix-map=$PWD=. -c -o $output 2> $output.stderr
+status=$?
+cat $output.stderr >&2
+if [[ $status -eq 0 ]];
+then
+  # written under a temporary name and renamed, so concurrent runs never
+  # see half an object
+  mkdir -p $(dirname $entry)
+  tmp=$(mktemp $entry.XXXXXX)
+  cp $output $tmp && mv -f $output.stderr $entry.stderr && mv -f $tmp $entry.o
+  rm -f $tmp
+fi
+rm -f $output.stderr
+echo "miss $key" >> $OBJCACHE_LOG
+exit $status
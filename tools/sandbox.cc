@@ -0,0 +1,525 @@
+//
+// Runs a command for one student inside Linux namespaces instead of a docker
+// container. See "sandbox -h" and README.md.
+//
+// The command sees a read-only copy of the toolchain directories, a private
+// /tmp, /proc and /dev, no network and the student's directory, which is the
+// only place outside /tmp it can write to besides the -w directories. An
+// unprivileged user namespace is used, so no daemon or root is needed.
+//
+// With -l, the student's directory is instead an overlay: the -l directories
+// stacked read-only over the student's, with every write going to a scratch
+// layer that is thrown away, or kept in the -u directory.
+//
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/securebits.h>
+#include <sys/mount.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <string>
+#include <vector>
+
+#define ROOT "/tmp/.sandbox" // where the new root is assembled, inside a private tmpfs
+
+/*
+ * Sandbox settings, from the command line.
+ */
+struct Options {
+    std::string dir;                    // the student's directory, writable
+    std::vector<std::string> layers;    // read-only layers over the student's directory, topmost first
+    std::string upper;                  // keeps the writes to an overlaid student directory
+    std::vector<std::string> toolchain; // directories mounted read-only
+    std::vector<std::string> extra;     // more directories mounted read-only
+    std::vector<std::string> shared;    // directories mounted writable, e.g. a cache shared by students
+    long file_mb = 1024;                // largest file the command may write
+    long open_files = 1024;
+    long cpu_seconds = 0;               // 0 for no limit
+    std::string cgroup;                 // delegated cgroup v2 directory to create a child cgroup in
+    long memory_mb = 0;                 // memory.max of the child cgroup, 0 for no limit
+    long pids = 0;                      // pids.max of the child cgroup, 0 for no limit
+    bool quiet = false;
+    char** command = NULL;
+};
+
+static struct timespec started;
+
+static double ms_since(const struct timespec& start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start.tv_sec) * 1000.0 + (now.tv_nsec - start.tv_nsec) / 1e6;
+}
+
+/*!
+ * Print the failed call and errno, then exit. Exits with 125, like
+ * "timeout" and "docker run", so the caller can tell a sandbox failure
+ * from a failure of the command.
+ */
+static void die(const std::string& what) {
+    fprintf(stderr, "sandbox: %s: %s\n", what.c_str(), strerror(errno));
+    exit(125);
+}
+
+static void write_file(const std::string& path, const std::string& text) {
+    int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0 || write(fd, text.c_str(), text.size()) != (ssize_t) text.size()) {
+        die("write " + path);
+    }
+    close(fd);
+}
+
+static void make_dirs(const std::string& path) {
+    for (size_t i = 1; i <= path.size(); i++) {
+        if (i == path.size() || path[i] == '/') {
+            if (mkdir(path.substr(0, i).c_str(), 0755) < 0 && errno != EEXIST) {
+                die("mkdir " + path.substr(0, i));
+            }
+        }
+    }
+}
+
+static void make_file(const std::string& path) {
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        die("create " + path);
+    }
+    close(fd);
+}
+
+/*!
+ * Make the bind mount at "dest" read-only.
+ */
+static void remount_read_only(const std::string& dest) {
+    // a remount in a user namespace must keep the flags locked by the parent namespace
+    struct statvfs vfs;
+    if (statvfs(dest.c_str(), &vfs) < 0) {
+        die("statvfs " + dest);
+    }
+    unsigned long flags = MS_BIND | MS_REMOUNT | MS_RDONLY;
+    flags |= (vfs.f_flag & ST_NOSUID) ? MS_NOSUID : 0;
+    flags |= (vfs.f_flag & ST_NODEV) ? MS_NODEV : 0;
+    flags |= (vfs.f_flag & ST_NOEXEC) ? MS_NOEXEC : 0;
+    flags |= (vfs.f_flag & ST_NOATIME) ? MS_NOATIME : 0;
+    flags |= (vfs.f_flag & ST_NODIRATIME) ? MS_NODIRATIME : 0;
+    flags |= (vfs.f_flag & ST_RELATIME) ? MS_RELATIME : 0;
+    if (mount(NULL, dest.c_str(), NULL, flags, NULL) < 0) {
+        die("remount read-only " + dest);
+    }
+}
+
+/*!
+ * Bind mount "source" at ROOT + "target", read-only unless "writable".
+ * A symlink, such as /lib -> usr/lib, is copied as a symlink instead.
+ */
+static void bind(const std::string& source, const std::string& target, bool writable) {
+    std::string dest = ROOT + target;
+    struct stat st;
+    if (lstat(source.c_str(), &st) < 0) {
+        die("stat " + source);
+    }
+    if (S_ISLNK(st.st_mode)) {
+        char link[PATH_MAX];
+        ssize_t n = readlink(source.c_str(), link, sizeof(link) - 1);
+        if (n < 0) {
+            die("readlink " + source);
+        }
+        link[n] = '\0';
+        make_dirs(dest.substr(0, dest.rfind('/')));
+        if (symlink(link, dest.c_str()) < 0) {
+            die("symlink " + dest);
+        }
+        return;
+    }
+    if (S_ISDIR(st.st_mode)) {
+        make_dirs(dest);
+    } else {
+        make_dirs(dest.substr(0, dest.rfind('/')));
+        make_file(dest);
+    }
+    if (mount(source.c_str(), dest.c_str(), NULL, MS_BIND | MS_REC, NULL) < 0) {
+        die("bind " + source);
+    }
+    if (!writable) {
+        remount_read_only(dest);
+    }
+}
+
+static void mount_tmpfs(const std::string& target, const char* options) {
+    make_dirs(target);
+    if (mount("tmpfs", target.c_str(), "tmpfs", MS_NOSUID | MS_NODEV, options) < 0) {
+        die("mount tmpfs " + target);
+    }
+}
+
+static int open_dir(const std::string& path) {
+    int fd = open(path.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        die("open " + path);
+    }
+    return fd;
+}
+
+static std::string fd_path(int fd) {
+    return "/proc/self/fd/" + std::to_string(fd);
+}
+
+/*!
+ * Bind mount the directory open as "fd" at ROOT + "target", read-only
+ * unless "writable".
+ */
+static void bind_dir(int fd, const std::string& target, bool writable) {
+    std::string dest = ROOT + target;
+    make_dirs(dest);
+    if (mount(fd_path(fd).c_str(), dest.c_str(), NULL, MS_BIND | MS_REC, NULL) < 0) {
+        die("bind " + target);
+    }
+    if (!writable) {
+        remount_read_only(dest);
+    }
+}
+
+/*!
+ * Mount the layers over the student directory at ROOT + dir. Writes go to
+ * "upper"/upper, or to the private /tmp when there is no upper directory.
+ * The directories are passed as open descriptors, so their paths may
+ * contain the ':' and ',' that separate overlay options.
+ */
+static void mount_overlay(const Options& options, int student, const std::vector<int>& layers, int upper) {
+    std::string lower;
+    for (int layer : layers) {
+        lower += fd_path(layer) + ":";
+    }
+    lower += fd_path(student);
+
+    std::string scratch = upper >= 0 ? fd_path(upper) : "/tmp/.scratch";
+    make_dirs(scratch + "/upper");
+    make_dirs(scratch + "/work");
+    std::string data = "lowerdir=" + lower + ",upperdir=" + scratch + "/upper,workdir=" +
+                       scratch + "/work,userxattr";
+    make_dirs(ROOT + options.dir);
+    if (mount("overlay", (ROOT + options.dir).c_str(), "overlay", MS_NOSUID | MS_NODEV, data.c_str()) < 0) {
+        die("mount overlay on " + options.dir);
+    }
+}
+
+static std::string cgroup_path(const Options& options) {
+    return options.cgroup + "/sandbox." + std::to_string(getpid());
+}
+
+/*!
+ * Create a child of the delegated cgroup with the memory and process
+ * limits, and move process "pid", and so everything it starts, into it.
+ */
+static void enter_cgroup(const Options& options, pid_t pid) {
+    std::string group = cgroup_path(options);
+    if (mkdir(group.c_str(), 0755) < 0) {
+        die("mkdir " + group);
+    }
+    if (options.memory_mb > 0) {
+        write_file(group + "/memory.max", std::to_string(options.memory_mb << 20));
+        write_file(group + "/memory.swap.max", "0");
+    }
+    if (options.pids > 0) {
+        write_file(group + "/pids.max", std::to_string(options.pids));
+    }
+    write_file(group + "/cgroup.procs", std::to_string(pid));
+}
+
+/*!
+ * Move this process into new user, mount, PID, network, IPC and UTS
+ * namespaces, mapping its user and group to themselves.
+ */
+static void enter_namespaces() {
+    uid_t uid = geteuid();
+    gid_t gid = getegid();
+    if (unshare(CLONE_NEWUSER | CLONE_NEWNS | CLONE_NEWPID | CLONE_NEWNET | CLONE_NEWIPC | CLONE_NEWUTS) < 0) {
+        die("unshare");
+    }
+    write_file("/proc/self/setgroups", "deny");
+    write_file("/proc/self/uid_map", std::to_string(uid) + " " + std::to_string(uid) + " 1");
+    write_file("/proc/self/gid_map", std::to_string(gid) + " " + std::to_string(gid) + " 1");
+}
+
+/*!
+ * Assemble the new root under ROOT and switch to it. Must run as the
+ * first process of the new PID namespace, so that /proc shows it.
+ */
+static void enter_root(const Options& options) {
+    // open the student directories first, in case they live under /tmp
+    int student = open_dir(options.dir);
+    std::vector<int> layers;
+    for (const std::string& layer : options.layers) {
+        layers.push_back(open_dir(layer));
+    }
+    int upper = options.upper.empty() ? -1 : open_dir(options.upper);
+    std::vector<int> extra;
+    for (const std::string& dir : options.extra) {
+        extra.push_back(open_dir(dir));
+    }
+    std::vector<int> shared;
+    for (const std::string& dir : options.shared) {
+        shared.push_back(open_dir(dir));
+    }
+    if (mount(NULL, "/", NULL, MS_REC | MS_PRIVATE, NULL) < 0) {
+        die("make mounts private");
+    }
+    mount_tmpfs("/tmp", "mode=0755");
+    mount_tmpfs(ROOT, "mode=0755");
+
+    for (const std::string& dir : options.toolchain) {
+        if (access(dir.c_str(), F_OK) == 0) {
+            bind(dir, dir, false);
+        }
+    }
+
+    mount_tmpfs(std::string(ROOT) + "/tmp", "mode=1777");
+    mount_tmpfs(std::string(ROOT) + "/dev", "mode=0755");
+    for (const char* dev : {"/dev/null", "/dev/zero", "/dev/full", "/dev/random", "/dev/urandom"}) {
+        bind(dev, dev, true);
+    }
+    mount_tmpfs(std::string(ROOT) + "/dev/shm", "mode=1777");
+    symlink("/proc/self/fd", ROOT "/dev/fd");
+    symlink("/proc/self/fd/0", ROOT "/dev/stdin");
+    symlink("/proc/self/fd/1", ROOT "/dev/stdout");
+    symlink("/proc/self/fd/2", ROOT "/dev/stderr");
+
+    make_dirs(ROOT "/proc");
+    if (mount("proc", ROOT "/proc", "proc", MS_NOSUID | MS_NODEV | MS_NOEXEC, NULL) < 0) {
+        die("mount /proc");
+    }
+
+    if (layers.empty()) {
+        make_dirs(ROOT + options.dir);
+        if (mount(fd_path(student).c_str(), (ROOT + options.dir).c_str(), NULL, MS_BIND | MS_REC, NULL) < 0) {
+            die("bind " + options.dir);
+        }
+    } else {
+        mount_overlay(options, student, layers, upper);
+    }
+    close(student);
+    for (int layer : layers) {
+        close(layer);
+    }
+    if (upper >= 0) {
+        close(upper);
+    }
+    for (size_t i = 0; i < extra.size(); i++) {
+        bind_dir(extra[i], options.extra[i], false);
+        close(extra[i]);
+    }
+    for (size_t i = 0; i < shared.size(); i++) {
+        bind_dir(shared[i], options.shared[i], true);
+        close(shared[i]);
+    }
+
+    make_dirs(ROOT "/.old");
+    if (syscall(SYS_pivot_root, ROOT, ROOT "/.old") < 0) {
+        die("pivot_root");
+    }
+    if (chdir("/") < 0 || umount2("/.old", MNT_DETACH) < 0 || rmdir("/.old") < 0) {
+        die("detach the old root");
+    }
+    if (mount(NULL, "/", NULL, MS_REMOUNT | MS_RDONLY | MS_NOSUID | MS_NODEV, NULL) < 0) {
+        die("remount / read-only");
+    }
+    if (chdir(options.dir.c_str()) < 0) {
+        die("chdir " + options.dir);
+    }
+    sethostname("sandbox", 7);
+}
+
+static void set_limit(int resource, rlim_t value, const char* name) {
+    struct rlimit limit = {value, value};
+    if (setrlimit(resource, &limit) < 0) {
+        die(std::string("setrlimit ") + name);
+    }
+}
+
+/*!
+ * Drop every capability for good, so not even a command running as
+ * root in the namespace can undo the read-only mounts.
+ */
+static void drop_privileges() {
+    for (int cap = 0; prctl(PR_CAPBSET_READ, cap) >= 0; cap++) {
+        prctl(PR_CAPBSET_DROP, cap);
+    }
+    prctl(PR_SET_SECUREBITS, SECBIT_NOROOT | SECBIT_NOROOT_LOCKED | SECBIT_NO_SETUID_FIXUP |
+                             SECBIT_NO_SETUID_FIXUP_LOCKED | SECBIT_KEEP_CAPS_LOCKED);
+    if (prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0) < 0) {
+        die("no_new_privs");
+    }
+}
+
+/*!
+ * First process of the PID namespace. Runs the command, reaps any orphans
+ * it leaves and exits with its status. Exiting kills everything still
+ * running in the namespace.
+ */
+static int init(const Options& options) {
+    enter_root(options);
+    set_limit(RLIMIT_CORE, 0, "core");
+    set_limit(RLIMIT_FSIZE, (rlim_t) options.file_mb << 20, "fsize");
+    set_limit(RLIMIT_NOFILE, options.open_files, "nofile");
+    if (options.cpu_seconds > 0) {
+        set_limit(RLIMIT_CPU, options.cpu_seconds, "cpu");
+    }
+    drop_privileges();
+
+    pid_t command = fork();
+    if (command < 0) {
+        die("fork");
+    }
+    if (command == 0) {
+        if (!options.quiet) {
+            fprintf(stderr, "[ SANDBOX ] started in %.2f ms\n", ms_since(started));
+        }
+        execvp(options.command[0], options.command);
+        die(std::string("exec ") + options.command[0]);
+    }
+
+    int status;
+    pid_t pid;
+    while ((pid = wait(&status)) != command) {
+        if (pid < 0 && errno != EINTR) {
+            die("wait");
+        }
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+static void usage() {
+    printf("Usage: sandbox [options] -- command [args...]\n");
+    printf("-d DIR     Student directory, the only writable one besides /tmp (default .)\n");
+    printf("-l DIR     Stack DIR read-only over the student directory, which becomes\n");
+    printf("           read-only too; the first -l is on top. Writes are discarded\n");
+    printf("           unless -u is given\n");
+    printf("-u DIR     Keep the writes to the student directory in DIR/upper, e.g. on a\n");
+    printf("           tmpfs, so later commands see them\n");
+    printf("-r DIR     Also mount DIR read-only; replaces the default toolchain\n");
+    printf("           /usr /bin /sbin /lib /lib32 /lib64 /libx32 /etc /opt\n");
+    printf("-b DIR     Also mount DIR read-only, keeping the toolchain\n");
+    printf("-w DIR     Also mount DIR writable, e.g. a cache shared by several students\n");
+    printf("-f MB      Largest file the command may write (default 1024)\n");
+    printf("-n N       Most open files (default 1024)\n");
+    printf("-c SEC     CPU seconds before the command is killed (default no limit)\n");
+    printf("-g DIR     Delegated cgroup v2 directory for -m and -p\n");
+    printf("-m MB      Memory limit of the command and its children\n");
+    printf("-p N       Most processes the command may run at once\n");
+    printf("-q         Do not report the startup latency\n");
+}
+
+static Options parse(int argc, char** argv) {
+    Options options;
+    int opt;
+    while ((opt = getopt(argc, argv, "+d:l:u:r:b:w:f:n:c:g:m:p:qh")) != -1) {
+        switch (opt) {
+            case 'd': options.dir = optarg; break;
+            case 'l': options.layers.push_back(optarg); break;
+            case 'u': options.upper = optarg; break;
+            case 'r': options.toolchain.push_back(optarg); break;
+            case 'b': options.extra.push_back(optarg); break;
+            case 'w': options.shared.push_back(optarg); break;
+            case 'f': options.file_mb = atol(optarg); break;
+            case 'n': options.open_files = atol(optarg); break;
+            case 'c': options.cpu_seconds = atol(optarg); break;
+            case 'g': options.cgroup = optarg; break;
+            case 'm': options.memory_mb = atol(optarg); break;
+            case 'p': options.pids = atol(optarg); break;
+            case 'q': options.quiet = true; break;
+            default: usage(); exit(opt == 'h' ? 0 : 125);
+        }
+    }
+    if (optind >= argc) {
+        usage();
+        exit(125);
+    }
+    options.command = argv + optind;
+
+    char dir[PATH_MAX];
+    if (realpath(options.dir.empty() ? "." : options.dir.c_str(), dir) == NULL) {
+        die("realpath " + options.dir);
+    }
+    options.dir = dir;
+    for (std::vector<std::string>* dirs : {&options.extra, &options.shared}) {
+        for (std::string& path : *dirs) {
+            if (realpath(path.c_str(), dir) == NULL) {
+                die("realpath " + path);
+            }
+            path = dir;
+        }
+    }
+    if (options.toolchain.empty()) {
+        options.toolchain = {"/usr", "/bin", "/sbin", "/lib", "/lib32", "/lib64", "/libx32", "/etc", "/opt"};
+    }
+    if (!options.upper.empty() && options.layers.empty()) {
+        fprintf(stderr, "sandbox: -u needs at least one -l\n");
+        exit(125);
+    }
+    if ((options.memory_mb > 0 || options.pids > 0) && options.cgroup.empty()) {
+        fprintf(stderr, "sandbox: -m and -p need a delegated cgroup (-g)\n");
+        exit(125);
+    }
+    return options;
+}
+
+int main(int argc, char** argv) {
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    Options options = parse(argc, argv);
+
+    enter_namespaces();
+
+    // the child waits on "ready" until it has been moved into the cgroup
+    int ready[2];
+    if (pipe2(ready, O_CLOEXEC) < 0) {
+        die("pipe");
+    }
+    pid_t child = fork();
+    if (child < 0) {
+        die("fork");
+    }
+    if (child == 0) {
+        char go;
+        close(ready[1]);
+        if (read(ready[0], &go, 1) != 1) {
+            exit(125);
+        }
+        close(ready[0]);
+        exit(init(options));
+    }
+    close(ready[0]);
+    if (!options.cgroup.empty()) {
+        enter_cgroup(options, child);
+    }
+    if (write(ready[1], "1", 1) != 1) {
+        die("start the sandbox");
+    }
+    close(ready[1]);
+
+    // the command gets the terminal's signals directly; just wait for it
+    signal(SIGINT, SIG_IGN);
+    signal(SIGQUIT, SIG_IGN);
+    int status;
+    while (waitpid(child, &status, 0) < 0) {
+        if (errno != EINTR) {
+            die("waitpid");
+        }
+    }
+    if (!options.cgroup.empty()) {
+        rmdir(cgroup_path(options).c_str());
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}